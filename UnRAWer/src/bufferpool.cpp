@@ -0,0 +1,155 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "pch.h"
+
+#include "bufferpool.h"
+
+#ifndef _WIN32
+#    include <sys/mman.h>
+#endif
+
+// Buffer sizes are rounded up to this, it is also the huge page size
+static constexpr size_t kGranularity = size_t(2) << 20;
+
+PooledBuffer&
+PooledBuffer::operator=(PooledBuffer&& other) noexcept
+{
+    if (this != &other) {
+        release();
+        m_pool       = other.m_pool;
+        m_data       = other.m_data;
+        m_size       = other.m_size;
+        other.m_pool = nullptr;
+        other.m_data = nullptr;
+        other.m_size = 0;
+    }
+    return *this;
+}
+
+void
+PooledBuffer::release()
+{
+    if (m_data && m_pool) {
+        m_pool->giveBack(m_data, m_size);
+    }
+    m_pool = nullptr;
+    m_data = nullptr;
+    m_size = 0;
+}
+
+void
+BufferPool::configure(size_t idleLimit, bool hugePages)
+{
+    clear();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_idleLimit = idleLimit;
+    m_hugePages = hugePages;
+}
+
+PooledBuffer
+BufferPool::acquire(size_t bytes)
+{
+    size_t size = (bytes + kGranularity - 1) / kGranularity * kGranularity;
+
+    PooledBuffer buffer;
+    buffer.m_pool = this;
+    {
+        // smallest idle buffer that fits and does not waste more than a quarter of it
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_idle.lower_bound(size);
+        if (it != m_idle.end() && it->first <= size + size / 4) {
+            buffer.m_size = it->first;
+            buffer.m_data = it->second;
+            m_idleBytes -= it->first;
+            m_idle.erase(it);
+            return buffer;
+        }
+    }
+
+    buffer.m_data = allocate(size);
+    if (!buffer.m_data) {
+        spdlog::error("Buffer pool: cannot allocate {} MB", size >> 20);
+        buffer.m_pool = nullptr;
+        return buffer;
+    }
+    buffer.m_size = size;
+    spdlog::trace("Buffer pool: allocated {} MB", size >> 20);
+    return buffer;
+}
+
+void
+BufferPool::giveBack(void* data, size_t size)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_idleBytes + size <= m_idleLimit) {
+            m_idle.emplace(size, data);
+            m_idleBytes += size;
+            return;
+        }
+    }
+    deallocate(data, size);
+}
+
+void
+BufferPool::clear()
+{
+    std::multimap<size_t, void*> idle;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        idle.swap(m_idle);
+        m_idleBytes = 0;
+    }
+    for (auto& [size, data] : idle) {
+        deallocate(data, size);
+    }
+}
+
+void*
+BufferPool::allocate(size_t size)
+{
+#ifdef _WIN32
+    if (m_hugePages && GetLargePageMinimum() > 0) {
+        // needs the "Lock pages in memory" privilege, plain pages otherwise
+        void* data = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (data) {
+            return data;
+        }
+    }
+    return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+    void* data = std::aligned_alloc(kGranularity, size);
+#    ifdef MADV_HUGEPAGE
+    if (data && m_hugePages) {
+        madvise(data, size, MADV_HUGEPAGE);
+    }
+#    endif
+    return data;
+#endif
+}
+
+void
+BufferPool::deallocate(void* data, size_t size)
+{
+    (void)size;
+#ifdef _WIN32
+    VirtualFree(data, 0, MEM_RELEASE);
+#else
+    std::free(data);
+#endif
+}
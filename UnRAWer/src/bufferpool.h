@@ -0,0 +1,82 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#ifndef BUFFERPOOL_H
+#    define BUFFERPOOL_H
+
+#    include <cstddef>
+#    include <map>
+#    include <mutex>
+
+class BufferPool;
+
+// Pixel storage leased from a BufferPool, goes back to the pool when destroyed
+class PooledBuffer {
+public:
+    PooledBuffer() = default;
+    PooledBuffer(const PooledBuffer&) = delete;
+    PooledBuffer& operator=(const PooledBuffer&) = delete;
+    PooledBuffer(PooledBuffer&& other) noexcept { *this = std::move(other); }
+    PooledBuffer& operator=(PooledBuffer&& other) noexcept;
+    ~PooledBuffer() { release(); }
+
+    void* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    explicit operator bool() const { return m_data != nullptr; }
+
+    void release();
+
+private:
+    friend class BufferPool;
+
+    BufferPool* m_pool = nullptr;
+    void* m_data       = nullptr;
+    size_t m_size      = 0;
+};
+
+// Reuses large 2 MB aligned pixel buffers across files, so full frame scratch images are not mapped,
+// page faulted and unmapped again for every file. Idle buffers are kept up to a byte limit.
+class BufferPool {
+public:
+    ~BufferPool() { clear(); }
+
+    // idleLimit - bytes of idle buffers kept, 0 disables pooling; hugePages - back buffers by large pages
+    void configure(size_t idleLimit, bool hugePages);
+
+    PooledBuffer acquire(size_t bytes);
+
+    // Frees all idle buffers
+    void clear();
+
+private:
+    friend class PooledBuffer;
+
+    void giveBack(void* data, size_t size);
+
+    void* allocate(size_t size);
+    void deallocate(void* data, size_t size);
+
+    std::mutex m_mutex;
+    std::multimap<size_t, void*> m_idle;  // size -> buffer
+    size_t m_idleBytes = 0;
+    size_t m_idleLimit = 0;
+    bool m_hugePages   = false;
+};
+
+#endif  // !BUFFERPOOL_H
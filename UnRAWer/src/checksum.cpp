@@ -0,0 +1,253 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "pch.h"
+
+#include "checksum.h"
+
+#include <cstring>
+
+using namespace OIIO;
+
+static constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+static constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+static constexpr uint64_t kPrime3 = 0x165667B19E3779F9ull;
+static constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ull;
+static constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ull;
+
+static inline uint64_t
+rotl(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t
+read64(const uint8_t* p)
+{
+    uint64_t v;
+    std::memcpy(&v, p, 8);  // little-endian hosts only, as the rest of the writers
+    return v;
+}
+
+static inline uint32_t
+read32(const uint8_t* p)
+{
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+static inline uint64_t
+round(uint64_t acc, uint64_t input)
+{
+    acc += input * kPrime2;
+    acc = rotl(acc, 31);
+    return acc * kPrime1;
+}
+
+static inline uint64_t
+mergeRound(uint64_t acc, uint64_t val)
+{
+    acc ^= round(0, val);
+    return acc * kPrime1 + kPrime4;
+}
+
+void
+Xxh64::update(const void* data, size_t size)
+{
+    const uint8_t* p   = static_cast<const uint8_t*>(data);
+    const uint8_t* end = p + size;
+    m_total += size;
+
+    if (m_buffered + size < 32) {
+        std::memcpy(m_buffer + m_buffered, p, size);
+        m_buffered += size;
+        return;
+    }
+    if (m_buffered) {
+        const size_t fill = 32 - m_buffered;
+        std::memcpy(m_buffer + m_buffered, p, fill);
+        p += fill;
+        for (int i = 0; i < 4; i++) {
+            m_acc[i] = round(m_acc[i], read64(m_buffer + i * 8));
+        }
+        m_buffered = 0;
+    }
+    uint64_t v1 = m_acc[0], v2 = m_acc[1], v3 = m_acc[2], v4 = m_acc[3];
+    for (; p + 32 <= end; p += 32) {
+        v1 = round(v1, read64(p));
+        v2 = round(v2, read64(p + 8));
+        v3 = round(v3, read64(p + 16));
+        v4 = round(v4, read64(p + 24));
+    }
+    m_acc[0] = v1, m_acc[1] = v2, m_acc[2] = v3, m_acc[3] = v4;
+    m_buffered = size_t(end - p);
+    std::memcpy(m_buffer, p, m_buffered);
+}
+
+uint64_t
+Xxh64::digest() const
+{
+    uint64_t h;
+    if (m_total >= 32) {
+        h = rotl(m_acc[0], 1) + rotl(m_acc[1], 7) + rotl(m_acc[2], 12) + rotl(m_acc[3], 18);
+        for (int i = 0; i < 4; i++) {
+            h = mergeRound(h, m_acc[i]);
+        }
+    } else {
+        h = kPrime5;  // seed 0
+    }
+    h += m_total;
+
+    const uint8_t* p   = m_buffer;
+    const uint8_t* end = m_buffer + m_buffered;
+    for (; p + 8 <= end; p += 8) {
+        h ^= round(0, read64(p));
+        h = rotl(h, 27) * kPrime1 + kPrime4;
+    }
+    if (p + 4 <= end) {
+        h ^= uint64_t(read32(p)) * kPrime1;
+        h = rotl(h, 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        h ^= (*p) * kPrime5;
+        h = rotl(h, 11) * kPrime1;
+    }
+
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    h ^= h >> 32;
+    return h;
+}
+
+HashingFile::HashingFile(const std::string& fileName)
+    : IOFile(fileName, Filesystem::IOProxy::Write)
+{
+}
+
+void
+HashingFile::hash(const void* buf, size_t size, int64_t offset)
+{
+    if (offset >= 0) {
+        m_end = std::max(m_end, uint64_t(offset) + size);
+    }
+    if (!m_inOrder || size == 0) {
+        return;
+    }
+    if (offset < 0 || uint64_t(offset) != m_hashed) {
+        m_inOrder = false;
+        return;
+    }
+    m_hash.update(buf, size);
+    m_hashed += size;
+}
+
+size_t
+HashingFile::write(const void* buf, size_t size)
+{
+    const int64_t offset = tell();
+    m_depth++;
+    size_t written = IOFile::write(buf, size);
+    m_depth--;
+    if (m_depth == 0) {
+        hash(buf, written, offset);
+    }
+    return written;
+}
+
+size_t
+HashingFile::pwrite(const void* buf, size_t size, int64_t offset)
+{
+    m_depth++;
+    size_t written = IOFile::pwrite(buf, size, offset);
+    m_depth--;
+    if (m_depth == 0) {
+        hash(buf, written, offset);
+    }
+    return written;
+}
+
+bool
+HashingFile::digest(OutputDigest& digest) const
+{
+    if (!m_inOrder || m_hashed != m_end) {
+        return false;
+    }
+    digestStreamed(m_hash, m_hashed, digest);
+    return true;
+}
+
+void
+digestStreamed(const Xxh64& hash, uint64_t size, OutputDigest& digest)
+{
+    digest.xxh64    = hash.digest();
+    digest.size     = size;
+    digest.streamed = true;
+    digest.valid    = true;
+}
+
+void
+digestBuffer(const void* data, size_t size, OutputDigest& digest)
+{
+    Xxh64 hash;
+    hash.update(data, size);
+    digestStreamed(hash, size, digest);
+}
+
+bool
+digestFile(const std::string& fileName, OutputDigest& digest)
+{
+#ifdef _WIN32
+    std::u8string u8name(fileName.begin(), fileName.end());
+    std::ifstream file(std::filesystem::path(u8name), std::ios::binary);
+#else
+    std::ifstream file(fileName, std::ios::binary);
+#endif
+    if (!file) {
+        spdlog::error("Checksum: Cannot read {}", fileName);
+        return false;
+    }
+    Xxh64 hash;
+    uint64_t size = 0;
+    std::vector<char> chunk(size_t(1) << 20);
+    while (file) {
+        file.read(chunk.data(), std::streamsize(chunk.size()));
+        const size_t got = size_t(file.gcount());
+        hash.update(chunk.data(), got);
+        size += got;
+    }
+    if (!file.eof()) {
+        spdlog::error("Checksum: Cannot read {}", fileName);
+        return false;
+    }
+    digest.xxh64    = hash.digest();
+    digest.size     = size;
+    digest.streamed = false;
+    digest.valid    = true;
+    return true;
+}
+
+std::string
+digestText(uint64_t digest)
+{
+    char text[17];
+    std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(digest));
+    return text;
+}
@@ -0,0 +1,89 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#ifndef CHECKSUM_H
+#    define CHECKSUM_H
+
+#    include <OpenImageIO/filesystem.h>
+
+#    include <cstddef>
+#    include <cstdint>
+#    include <string>
+
+// Streaming XXH64 (xxHash, 64 bit, seed 0)
+class Xxh64 {
+public:
+    void update(const void* data, size_t size);
+    uint64_t digest() const;
+
+private:
+    uint64_t m_acc[4] = { 0x60EA27EEADC0B5D6ull, 0xC2B2AE3D27D4EB4Full, 0, 0x61C8864E7A143579ull };
+    uint8_t m_buffer[32];
+    size_t m_buffered = 0;
+    uint64_t m_total  = 0;
+};
+
+// Checksum of a written output file
+struct OutputDigest {
+    uint64_t xxh64 = 0;
+    uint64_t size  = 0;
+    double seconds = 0.0;    // encode time
+    bool streamed  = false;  // hashed while written, otherwise read back
+    bool valid     = false;
+};
+
+// Output file for ImageOutput::set_ioproxy that hashes the bytes as they are written. The hash holds only while
+// the writer appends, a writer that seeks back to patch its header (TIFF) leaves it to digestFile().
+class HashingFile : public OIIO::Filesystem::IOFile {
+public:
+    explicit HashingFile(const std::string& fileName);
+
+    size_t write(const void* buf, size_t size) override;
+    size_t pwrite(const void* buf, size_t size, int64_t offset) override;
+
+    // Fills digest when every byte of the file was hashed in order
+    bool digest(OutputDigest& digest) const;
+
+private:
+    void hash(const void* buf, size_t size, int64_t offset);
+
+    Xxh64 m_hash;
+    uint64_t m_hashed = 0;  // bytes hashed, all written at offsets [0, m_hashed)
+    uint64_t m_end    = 0;  // end of the furthest write
+    bool m_inOrder    = true;
+    int m_depth       = 0;  // IOFile::write may forward to pwrite, only the outer call hashes
+};
+
+// Fills digest from the hash of every byte of a file, taken in order while it was written
+void
+digestStreamed(const Xxh64& hash, uint64_t size, OutputDigest& digest);
+
+// Fills digest from a file written from memory in one piece
+void
+digestBuffer(const void* data, size_t size, OutputDigest& digest);
+
+// Hashes a file by reading it back, right after a write it is served from the page cache
+bool
+digestFile(const std::string& fileName, OutputDigest& digest);
+
+// Lower case hex of a digest
+std::string
+digestText(uint64_t digest);
+
+#endif  // !CHECKSUM_H
@@ -98,12 +98,17 @@ cli_main(int argc, char* argv[])
     std::string configFile = "";
     std::vector<std::string> batchFiles;
     std::vector<std::string> filePaths;
+    std::vector<std::string> profiles;
+
+    const std::string profileFlag = "-profile=";
 
     // Iterate through command-line arguments
     for (; i < argc; ++i) {
         char* arg = argv[i];
 
-        if (endsWith(arg, configSuffix)) {
+        if (startsWith(arg, profileFlag)) {
+            profiles.push_back(std::string(arg).substr(profileFlag.size()));
+        } else if (endsWith(arg, configSuffix)) {
             if (configFile.empty()) {
                 configFile = arg;
             } else {
@@ -145,6 +150,13 @@ cli_main(int argc, char* argv[])
         settings.reSettings();
     }
 
+    // Command line compression profiles override the config file
+    for (const auto& profile : profiles) {
+        if (!setCompressionProfile(settings, profile)) {
+            std::cerr << "Warning: Unknown compression profile [" << profile << "]" << std::endl;
+        }
+    }
+
     if (verbosity > 2) {
         printSettings(settings);
     }
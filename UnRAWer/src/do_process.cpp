@@ -21,6 +21,7 @@
 
 #include "imageio.h"
 #include "do_process.h"
+#include "manifest.h"
 #include "processors.h"
 #include "settings.h"
 #include "Timer.h"
@@ -33,6 +34,49 @@ std::atomic_size_t fileCntr;
 
 ProcessGlobals procGlobals;
 
+// Files of a group scheduled back to back before the next group gets a turn
+static constexpr size_t kGroupRun = 256;
+
+// Reorders files so that files sharing a LUT run together and keep the LUT hot in the caches.
+// The key is the matched preset, plus folder and extension (camera stand-in) for per camera LUTs.
+// Groups take turns in runs of kGroupRun files in order of first appearance, so no folder waits for
+// the whole batch; files keep their scan order inside a group.
+static void
+groupByPreset(std::vector<std::string>& fileNames)
+{
+    std::unordered_map<std::string, size_t> groupIdx;
+    std::vector<std::vector<std::string>> groups;
+    for (auto& file : fileNames) {
+        auto [path, parentFolderName, baseName, extension] = splitPath(file);
+        std::string key = settings.lutMode > 0 ? settings.dLutPreset : "";
+        if (settings.lutMode == 0) {
+            key = getPresetfromName(parentFolderName + "/" + baseName).value_or("");
+        }
+        if (settings.perCamera) {
+            key += "|" + path + "|" + toLower(extension);
+        }
+        auto [it, added] = groupIdx.try_emplace(key, groups.size());
+        if (added) {
+            groups.emplace_back();
+        }
+        groups[it->second].push_back(std::move(file));
+    }
+
+    fileNames.clear();
+    std::vector<size_t> next(groups.size(), 0);
+    for (bool left = true; left;) {
+        left = false;
+        for (size_t g = 0; g < groups.size(); g++) {
+            size_t end = std::min(next[g] + kGroupRun, groups[g].size());
+            for (; next[g] < end; next[g]++) {
+                fileNames.push_back(std::move(groups[g][next[g]]));
+            }
+            left |= next[g] < groups[g].size();
+        }
+    }
+    spdlog::info("Files grouped by LUT: {} groups", groups.size());
+}
+
 // Step-based progress reporting
 bool
 doProgress(StepProgress* stepProgress, std::function<void(float, std::string)> callback,
@@ -115,6 +159,27 @@ doProcessing(const std::vector<std::string>& urls, std::function<void(float, std
 
     procGlobals.ocio_conf_ptr = std::make_unique<OIIO::ColorConfig>(settings.ocioConfigPath);
 
+    // LUTs every file is likely to use are built before the pipeline starts
+    std::vector<std::string> lut_prewarm;
+    if (settings.lutMode >= 0 && !settings.perCamera) {
+        lut_prewarm.push_back(settings.dLutPreset);
+        for (const auto& variant : settings.variants) {
+            if (!variant.lutPreset.empty() && variant.lutPreset != "none") {
+                lut_prewarm.push_back(variant.lutPreset);
+            }
+        }
+    }
+    procGlobals.lut_registry.init(procGlobals.ocio_conf_ptr.get(), lut_prewarm);
+    procGlobals.preset_matcher.init(settings.lut_Preset);
+    procGlobals.buffer_pool.configure(size_t(settings.bufferPool) << 20, settings.hugePages);
+    if (settings.checksums) {
+        manifestBegin();
+    }
+
+    if (settings.groupByPreset) {
+        groupByPreset(fileNames);
+    }
+
     std::vector<std::future<bool>> results;
 
     ///////////////////////////////////////////////////////////////////////////////////////////
@@ -134,6 +199,12 @@ doProcessing(const std::vector<std::string>& urls, std::function<void(float, std
     int process_size  = processThreads;   // 10
     int write_size    = writeThreads;     // 10
 
+    // every writer runs its JXL/HEIC encoder on a share of the cores instead of the encoders' defaults
+    procGlobals.encodeThreads = settings.encodeThreads > 0
+                                    ? settings.encodeThreads
+                                    : std::max(1, int(std::thread::hardware_concurrency()) / writeThreads);
+    spdlog::debug("Encoder threads per file: {}", procGlobals.encodeThreads);
+
     myPools.emplace("progress", std::make_unique<ThreadPool>(1, 1));                            // Progress pool
     myPools.emplace("sorter", std::make_unique<ThreadPool>(preThreads, pre_size));              // Preprocessor pool
     myPools.emplace("rawReader", std::make_unique<ThreadPool>(readThreads, read_size));         // Libraw Reader pool
@@ -183,6 +254,7 @@ doProcessing(const std::vector<std::string>& urls, std::function<void(float, std
     myPools["dcraw"]->waitForAllTasks();
     myPools["processor"]->waitForAllTasks();
     myPools["writer"]->waitForAllTasks();
+    procGlobals.buffer_pool.clear();
 
     stopProgress = true;
     myPools["progress"]->waitForAllTasks();
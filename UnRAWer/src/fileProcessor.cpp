@@ -49,21 +49,31 @@ getWritableExt(std::string* ext, Settings* settings)
 }
 
 std::string
-getExtension(std::string& extension, Settings* settings)
+getFormatExt(int fileFormat, Settings* settings)
 {
-    extension = toLower(extension);
-    switch (settings->fileFormat) {
-        //-1 - original, 0 - TIFF, 1 - OpenEXR, 2 - PNG, 3 - JPEG, 4 - JPEG-2000, 5 - JPEG-XL, 6 - HEIC, 7 - PPM
+    switch (fileFormat) {
+        //-1 - original, 0 - TIFF, 1 - OpenEXR, 2 - PNG, 3 - JPEG, 4 - JPEG-2000, 5 - JPEG-XL, 6 - HEIC, 7 - PPM, 8 - UNRW
     case 0: return ".tif";
     case 1: return ".exr";
     case 2: return ".png";
     case 3: return ".jpg";
-    case 4: return ".jp2";
+    case 4: return settings->htj2k ? ".j2c" : ".jp2";
     case 5: return ".jxl";
     case 6: return ".heic";
     case 7: return ".ppm";
+    case 8: return ".unrw";
     }
-    extension = "." + settings->out_formats[settings->defFormat];
+    return "." + settings->out_formats[settings->defFormat];
+}
+
+std::string
+getExtension(std::string& extension, Settings* settings)
+{
+    extension = toLower(extension);
+    if (settings->fileFormat >= 0 && settings->fileFormat <= 8) {
+        return getFormatExt(settings->fileFormat, settings);
+    }
+    extension = getFormatExt(settings->fileFormat, settings);
     return extension;
 }
 
@@ -79,24 +89,10 @@ splitPath(const std::string& fileName)
 }
 
 std::optional<std::string>
-getPresetfromName(const std::string& fileName, Settings* settings)
+getPresetfromName(const std::string& fileName)
 {
-    fs::path p(fileName);
-    std::string baseName = p.stem().string();
-    std::string path     = p.parent_path().string();
-
-    std::string baseNameLower = toLower(baseName);
-    std::string pathLower     = toLower(path);
-
-    // find if path or baseName contains any of settings.lut_Preset strings
-    for (auto& lut_preset : settings->lut_Preset) {
-        std::string lut_preset_key = toLower(lut_preset.first);
-        if (pathLower.find(lut_preset_key) != std::string::npos
-            || baseNameLower.find(lut_preset_key) != std::string::npos) {
-            return lut_preset.first;
-        }
-    }
-    return std::nullopt;
+    // longest preset name found in the parent folder or base name, see PresetMatcher
+    return procGlobals.preset_matcher.match(fileName);
 }
 
 FileStepInfo
@@ -111,6 +107,15 @@ countExpectedSteps(const Settings& settings, const std::optional<std::string>& l
     // Step 2: Unpack (LUnpacker)
     info.stepCount++;
 
+    // Proxy mode: embedded preview is written as is
+    if (settings.proxyMode) {
+        info.hasDemosaic = false;
+        info.hasLUT      = false;
+        info.hasSharp    = false;
+        info.stepCount++;
+        return info;
+    }
+
     // Step 3: Demosaic (if enabled)
     info.hasDemosaic = (settings.dDemosaic > -1);
     if (info.hasDemosaic) {
@@ -26,6 +26,9 @@
 #include <atomic>
 
 #include "imageio.h"
+#include "bufferpool.h"
+#include "lutregistry.h"
+#include "presetmatcher.h"
 
 #ifndef FILEPROCESSOR_H
 #    define FILEPROCESSOR_H
@@ -184,7 +187,20 @@ struct StepProgress {
     }
 };
 
+// Output variant of a file, rendered from the same decoded image as the main export
+struct VariantOutput {
+    size_t variant;       // Index in settings.variants
+    int fileFormat;       // Resolved output file format
+    std::string outFile;  // Output file name without extension
+    std::string outExt;   // Output file name extension
+    std::string lut_preset;
+    std::array<int, 4> crops;
+    std::unique_ptr<OIIO::ImageBuf> image;
+    std::unique_ptr<OIIO::ImageSpec> outSpec;
+};
+
 struct ProcessingParams {
+    PooledBuffer scratch;  // pooled pixel storage wrapped by image, kept until the file is written
     std::unique_ptr<OIIO::ImageBuf> image;
     // File paths:
     std::string srcFile;  // Source file full path name
@@ -210,6 +226,12 @@ struct ProcessingParams {
     // Processing params:
     std::string lut_preset;
 
+    // Output variants, written in parallel with the main export
+    std::vector<VariantOutput> variants;
+    // Extra file formats encoded from the main export's processed image, concurrently with it
+    std::vector<int> extraFormats;
+    std::atomic<int> pendingWrites { 0 };
+
     // Filters:
     struct sharpening {
         bool enabled;
@@ -227,6 +249,8 @@ struct ProcessingParams {
         int left, top, width, height;
     } m_crops;
 
+    int orientation = 1;  // Exif Orientation tag, pixels are left in sensor orientation when it is not 1
+
     struct exif {
         std::string make, model, lens, serial, software, date, time;
         float fnumber, focal, iso, shutter;
@@ -297,6 +321,10 @@ struct ProcessingParams {
 
 struct ProcessGlobals {
     std::unique_ptr<OIIO::ColorConfig> ocio_conf_ptr;  // per session color config load
+    LutRegistry lut_registry;                          // per batch LUT processors
+    PresetMatcher preset_matcher;                      // per batch preset name matcher
+    BufferPool buffer_pool;                            // scratch image storage reused across files
+    int encodeThreads = 1;                             // JXL/HEIC encoder threads per written file
     struct PreviewSink {
         using EnqueueFn = void (*)(void* user, const char* out_file_path, int file_index1, int total_files);
         std::atomic<EnqueueFn> enqueue { nullptr };
@@ -314,6 +342,9 @@ toLower(const std::string& str);
 void
 getWritableExt(std::string* ext, Settings* settings);
 
+std::string
+getFormatExt(int fileFormat, Settings* settings);
+
 std::string
 getExtension(std::string& extension, Settings* settings);
 
@@ -321,7 +352,7 @@ std::tuple<std::string, std::string, std::string, std::string>
 splitPath(const std::string& fileName);
 
 std::optional<std::string>
-getPresetfromName(const std::string& fileName, Settings* settings);
+getPresetfromName(const std::string& fileName);
 
 std::tuple<std::string, std::string, std::string>
 getOutName(std::string& path, std::string& baseName, std::string& extension, std::string& prest_sfx,
@@ -357,6 +357,15 @@ AppMenuBar()
             if (ImGui::MenuItem("Half Resolution", NULL, settings.rawParms.half_size)) {
                 settings.rawParms.half_size = !settings.rawParms.half_size;
             }
+            if (ImGui::MenuItem("Fused Conversion", NULL, settings.fusedConvert)) {
+                settings.fusedConvert = !settings.fusedConvert;
+            }
+            if (ImGui::MenuItem("Embedded Preview (Proxy)", NULL, settings.proxyMode)) {
+                settings.proxyMode = !settings.proxyMode;
+            }
+            if (ImGui::MenuItem("Orientation as Metadata", NULL, settings.orientMeta)) {
+                settings.orientMeta = !settings.orientMeta;
+            }
 
             ImGui::EndMenu();
         }
@@ -457,6 +466,11 @@ AppMenuBar()
                 MenuRadio("JPEG-XL", settings.fileFormat, 5);
                 MenuRadio("HEIC", settings.fileFormat, 6);
                 MenuRadio("PPM", settings.fileFormat, 7);
+                MenuRadio("UNRW (uncompressed)", settings.fileFormat, 8);
+                ImGui::Separator();
+                if (ImGui::MenuItem("JPEG2000 as HTJ2K", NULL, settings.htj2k)) {
+                    settings.htj2k = !settings.htj2k;
+                }
                 ImGui::EndMenu();
             }
 
@@ -0,0 +1,171 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "pch.h"
+
+#include "heifwriter.h"
+#include "checksum.h"
+
+#include <OpenImageIO/tiffutils.h>
+
+#include <cstring>
+
+#include <libheif/heif.h>
+
+using namespace OIIO;
+
+static bool
+heifCheck(const heif_error& err, const char* what, const std::string& fileName)
+{
+    if (err.code != heif_error_Ok) {
+        spdlog::error("HEIC: {} failed for {}: {}", what, fileName, err.message ? err.message : "");
+        return false;
+    }
+    return true;
+}
+
+static heif_error
+writeToVector(heif_context*, const void* data, size_t size, void* userdata)
+{
+    auto* out         = static_cast<std::vector<uint8_t>*>(userdata);
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    out->insert(out->end(), bytes, bytes + size);
+    return heif_error { heif_error_Ok, heif_suberror_Unspecified, "" };
+}
+
+bool
+heifWrite(const ImageBuf& buf, const ImageSpec& spec, int x, int y, const std::string& fileName, int quality,
+          const std::string& preset, int threads, OutputDigest* digest)
+{
+    const int width  = spec.width;
+    const int height = spec.height;
+    const int nch    = spec.nchannels >= 4 ? 4 : 3;  // gray is expanded to RGB below
+
+    std::unique_ptr<heif_context, decltype(&heif_context_free)> ctx(heif_context_alloc(), heif_context_free);
+    heif_encoder* encoder_ptr = nullptr;
+    if (!heifCheck(heif_context_get_encoder_for_format(ctx.get(), heif_compression_HEVC, &encoder_ptr), "encoder",
+                   fileName)) {
+        return false;
+    }
+    std::unique_ptr<heif_encoder, decltype(&heif_encoder_release)> encoder(encoder_ptr, heif_encoder_release);
+    if (quality >= 100) {
+        heif_encoder_set_lossless(encoder.get(), 1);
+    } else {
+        heif_encoder_set_lossy_quality(encoder.get(), quality);
+    }
+    // x265 options are passed through by libheif's x265 plugin; unknown ones only fail the call
+    heif_encoder_set_parameter_string(encoder.get(), "preset", preset.c_str());
+    std::string pools = std::to_string(std::max(threads, 1));
+    heif_encoder_set_parameter_string(encoder.get(), "x265:pools", pools.c_str());
+    heif_encoder_set_parameter_string(encoder.get(), "x265:frame-threads", "1");
+
+    // formats wider than 8 bits are encoded as 10 bit (HEVC Main 10) from 16 bit little endian samples
+    const bool deep          = spec.format.basesize() > 1;
+    const heif_chroma chroma = nch == 4 ? (deep ? heif_chroma_interleaved_RRGGBBAA_LE : heif_chroma_interleaved_RGBA)
+                                        : (deep ? heif_chroma_interleaved_RRGGBB_LE : heif_chroma_interleaved_RGB);
+    heif_image* image_ptr = nullptr;
+    if (!heifCheck(heif_image_create(width, height, heif_colorspace_RGB, chroma, &image_ptr), "image", fileName)) {
+        return false;
+    }
+    std::unique_ptr<heif_image, decltype(&heif_image_release)> image(image_ptr, heif_image_release);
+    if (!heifCheck(heif_image_add_plane(image.get(), heif_channel_interleaved, width, height, deep ? 10 : 8),
+                   "plane", fileName)) {
+        return false;
+    }
+    int stride     = 0;
+    uint8_t* plane = heif_image_get_plane(image.get(), heif_channel_interleaved, &stride);
+
+    const int src_nch = std::min(spec.nchannels, nch);
+    std::vector<uint8_t> row(size_t(width) * src_nch * (deep ? 2 : 1));
+    for (int r = 0; r < height; r++) {
+        if (!buf.get_pixels(ROI(x, x + width, y + r, y + r + 1, 0, 1, 0, src_nch),
+                            deep ? TypeDesc::UINT16 : TypeDesc::UINT8, row.data())) {
+            spdlog::error("HEIC: Cannot read pixels of {}", fileName);
+            return false;
+        }
+        uint8_t* dst = plane + size_t(stride) * r;
+        if (deep) {
+            const uint16_t* src = reinterpret_cast<const uint16_t*>(row.data());
+            for (int i = 0; i < width; i++) {
+                for (int c = 0; c < nch; c++) {
+                    const int v     = std::min((src[i * src_nch + (src_nch == nch ? c : 0)] + 32) >> 6, 1023);
+                    uint8_t* sample = dst + (size_t(i) * nch + c) * 2;
+                    sample[0]       = static_cast<uint8_t>(v);
+                    sample[1]       = static_cast<uint8_t>(v >> 8);
+                }
+            }
+        } else if (src_nch == nch) {
+            std::memcpy(dst, row.data(), row.size());
+        } else {
+            for (int i = 0; i < width; i++) {
+                dst[i * 3] = dst[i * 3 + 1] = dst[i * 3 + 2] = row[i * src_nch];
+            }
+        }
+    }
+
+    const ParamValue* icc = spec.find_attribute("ICCProfile");
+    if (icc) {
+        heif_image_set_raw_color_profile(image.get(), "prof", icc->data(), icc->datasize());
+    }
+
+    std::unique_ptr<heif_encoding_options, decltype(&heif_encoding_options_free)> options(
+        heif_encoding_options_alloc(), heif_encoding_options_free);
+#if LIBHEIF_HAVE_VERSION(1, 14, 0)
+    options->image_orientation = static_cast<heif_orientation>(
+        std::clamp(spec.get_int_attribute("Orientation", 1), 1, 8));
+#endif
+
+    heif_image_handle* handle = nullptr;
+    if (!heifCheck(heif_context_encode_image(ctx.get(), image.get(), encoder.get(), options.get(), &handle), "encoding",
+                   fileName)) {
+        return false;
+    }
+    std::vector<char> exif;
+    encode_exif(spec, exif);
+    if (!exif.empty()) {
+        heifCheck(heif_context_add_exif_metadata(ctx.get(), handle, exif.data(), static_cast<int>(exif.size())),
+                  "Exif", fileName);
+    }
+    heif_image_handle_release(handle);
+
+    std::vector<uint8_t> out;
+    heif_writer writer;
+    writer.writer_api_version = 1;
+    writer.write              = writeToVector;
+    if (!heifCheck(heif_context_write(ctx.get(), &writer, &out), "writing", fileName)) {
+        return false;
+    }
+
+#ifdef _WIN32
+    std::u8string u8name(fileName.begin(), fileName.end());
+    std::ofstream file(std::filesystem::path(u8name), std::ios::binary);
+#else
+    std::ofstream file(fileName, std::ios::binary);
+#endif
+    file.write(reinterpret_cast<const char*>(out.data()), static_cast<std::streamsize>(out.size()));
+    file.close();
+    if (!file) {
+        spdlog::error("HEIC: Cannot write {}", fileName);
+        return false;
+    }
+    if (digest) {
+        digestBuffer(out.data(), out.size(), *digest);
+    }
+    spdlog::debug("HEIC: {} {} bit, preset {} {} threads, {} bytes", fileName, deep ? 10 : 8, preset, threads,
+                  out.size());
+    return true;
+}
@@ -0,0 +1,155 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "pch.h"
+
+#include "htj2kwriter.h"
+#include "checksum.h"
+
+#ifdef UNRAWER_WITH_OPENJPH
+#    include <openjph/ojph_arch.h>
+#    include <openjph/ojph_codestream.h>
+#    include <openjph/ojph_file.h>
+#    include <openjph/ojph_mem.h>
+#    include <openjph/ojph_params.h>
+#endif
+
+using namespace OIIO;
+
+#ifdef UNRAWER_WITH_OPENJPH
+
+// Rows converted per get_pixels call
+static constexpr int kBandRows = 64;
+
+// Irreversible quantization step of a quality value, the step halves every 11.875 quality points so
+// 95 gives OpenJPH's default of 1/256
+static float
+qualityStep(int quality)
+{
+    return std::exp2(-std::clamp(quality, 1, 99) / 11.875f);
+}
+
+template<typename T>
+static void
+feedBand(ojph::codestream& codestream, ojph::line_buf*& line, ojph::ui32& comp, const T* band, int width, int rows,
+         int nch)
+{
+    for (int r = 0; r < rows; r++) {
+        const T* row = band + size_t(r) * width * nch;
+        for (int c = 0; c < nch; c++) {
+            ojph::si32* dst = line->i32;
+            const T* src    = row + comp;
+            for (int i = 0; i < width; i++, src += nch) {
+                dst[i] = static_cast<ojph::si32>(*src);
+            }
+            line = codestream.exchange(line, comp);
+        }
+    }
+}
+
+bool
+htj2kWrite(const ImageBuf& buf, const ImageSpec& spec, int x, int y, const std::string& fileName, int quality,
+           OutputDigest* digest)
+{
+    const int width       = spec.width;
+    const int height      = spec.height;
+    const int nch         = spec.nchannels >= 3 ? 3 : 1;  // alpha and extra channels are dropped
+    const bool is8bit     = spec.format == TypeDesc::UINT8;
+    const bool lossless   = quality >= 100;
+    const TypeDesc format = is8bit ? TypeDesc::UINT8 : TypeDesc::UINT16;
+
+    std::vector<uint8_t> band(size_t(width) * std::min(kBandRows, height) * nch * format.size());
+    ojph::mem_outfile out;
+    try {
+        ojph::codestream codestream;
+        ojph::param_siz siz = codestream.access_siz();
+        siz.set_image_extent(ojph::point(width, height));
+        siz.set_num_components(nch);
+        for (int c = 0; c < nch; c++) {
+            siz.set_component(c, ojph::point(1, 1), is8bit ? 8 : 16, false);
+        }
+        siz.set_image_offset(ojph::point(0, 0));
+        siz.set_tile_size(ojph::size(0, 0));
+        siz.set_tile_offset(ojph::point(0, 0));
+
+        ojph::param_cod cod = codestream.access_cod();
+        cod.set_num_decomposition(5);
+        cod.set_block_dims(64, 64);
+        cod.set_progression_order("RPCL");
+        cod.set_color_transform(nch == 3);
+        cod.set_reversible(lossless);
+        if (!lossless) {
+            codestream.access_qcd().set_irrev_quant(qualityStep(quality));
+        }
+        codestream.set_planar(false);
+
+        out.open();
+        codestream.write_headers(&out);
+
+        ojph::ui32 comp      = 0;
+        ojph::line_buf* line = codestream.exchange(nullptr, comp);
+        for (int y0 = 0; y0 < height; y0 += kBandRows) {
+            const int rows = std::min(kBandRows, height - y0);
+            ROI roi(x, x + width, y + y0, y + y0 + rows, 0, 1, 0, nch);
+            if (!buf.get_pixels(roi, format, band.data())) {
+                spdlog::error("HTJ2K: Cannot read pixels of {}", fileName);
+                return false;
+            }
+            if (is8bit) {
+                feedBand(codestream, line, comp, band.data(), width, rows, nch);
+            } else {
+                feedBand(codestream, line, comp, reinterpret_cast<const uint16_t*>(band.data()), width, rows, nch);
+            }
+        }
+        codestream.flush();
+        codestream.close();
+    } catch (const std::exception& e) {
+        spdlog::error("HTJ2K: {}: {}", fileName, e.what());
+        return false;
+    }
+
+#    ifdef _WIN32
+    std::u8string u8name(fileName.begin(), fileName.end());
+    std::ofstream file(std::filesystem::path(u8name), std::ios::binary);
+#    else
+    std::ofstream file(fileName, std::ios::binary);
+#    endif
+    file.write(reinterpret_cast<const char*>(out.get_data()), static_cast<std::streamsize>(out.tell()));
+    file.close();
+    if (!file) {
+        spdlog::error("HTJ2K: Cannot write {}", fileName);
+        return false;
+    }
+    if (digest) {
+        digestBuffer(out.get_data(), size_t(out.tell()), *digest);
+    }
+    spdlog::debug("HTJ2K: {} {} bytes, quantization step {}", fileName, out.tell(),
+                  lossless ? 0.0f : qualityStep(quality));
+    return true;
+}
+
+#else
+
+bool
+htj2kWrite(const ImageBuf& buf, const ImageSpec& spec, int x, int y, const std::string& fileName, int quality,
+           OutputDigest* digest)
+{
+    spdlog::error("HTJ2K: UnRAWer is built without OpenJPH, {} is not written", fileName);
+    return false;
+}
+
+#endif
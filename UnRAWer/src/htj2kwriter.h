@@ -0,0 +1,39 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#ifndef HTJ2KWRITER_H
+#    define HTJ2KWRITER_H
+
+#    include <OpenImageIO/imagebuf.h>
+
+#    include <string>
+
+struct OutputDigest;
+
+// Writes a High-Throughput JPEG 2000 (HTJ2K) codestream (.j2c) with OpenJPH.
+// uint8 images are stored as 8 bit, every other format as 16 bit unsigned; 3+ channel images use the
+// reversible (lossless) or irreversible colour transform. quality 100 is lossless, lower values map
+// to a coarser quantization step. spec gives the written size, pixels are read from buf at (x, y).
+// digest, if given, is filled from the encoded codestream before it is written.
+// Returns false if UnRAWer is built without UNRAWER_WITH_OPENJPH.
+bool
+htj2kWrite(const OIIO::ImageBuf& buf, const OIIO::ImageSpec& spec, int x, int y, const std::string& fileName,
+           int quality, OutputDigest* digest = nullptr);
+
+#endif  // !HTJ2KWRITER_H
@@ -22,12 +22,16 @@
 #include <string>
 #include <array>
 #include <memory>
+#include <vector>
 
 #include <OpenImageIO/imageio.h>
 #include <OpenImageIO/imagebuf.h>
 
 using namespace OIIO;
 
+class LibRaw;  // forward declaration
+struct OutputDigest;
+
 bool
 m_progress_callback(void* opaque_data, float portion_done);
 
@@ -43,13 +47,14 @@ img_load(const std::string& inputFileName);
 
 bool
 img_write(std::unique_ptr<ImageBuf>& out_buf, std::unique_ptr<ImageSpec>& out_spec, const std::string& outputFileName,
-          std::array<int, 4> crops);
+          std::array<int, 4> crops, int fileFormat,
+          const std::vector<std::unique_ptr<ImageBuf>>* subimages = nullptr, OutputDigest* digest = nullptr);
 
 bool
 makePath(const std::string& out_path);
 
 bool
-thumb_load(ImageBuf& outBuf, const std::string inputFileName);
+thumb_load(LibRaw& raw_processor, ImageBuf& outBuf);
 
 void
 debugImageBufWrite(const ImageBuf& buf, const std::string& filename);
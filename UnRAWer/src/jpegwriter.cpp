@@ -0,0 +1,274 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "pch.h"
+
+#include "jpegwriter.h"
+#include "checksum.h"
+
+#include <OpenImageIO/parallel.h>
+#include <OpenImageIO/tiffutils.h>
+
+#include <csetjmp>
+#include <cstdio>
+
+#include <jpeglib.h>
+
+using namespace OIIO;
+
+// Stripes per thread, a few more than threads so uneven stripes balance out
+static constexpr int kStripesPerThread = 2;
+// Smallest stripe, shorter stripes only add restart and task overhead
+static constexpr int kMinStripeRows = 64;
+// 4:4:4 MCU height
+static constexpr int kMcuRows = 8;
+
+struct JpegError {
+    jpeg_error_mgr pub;
+    jmp_buf jump;
+    char message[JMSG_LENGTH_MAX];
+    unsigned char* mem   = nullptr;  // jpeg_mem_dest buffer, kept here so it survives longjmp
+    unsigned long length = 0;
+};
+
+static void
+errorExit(j_common_ptr cinfo)
+{
+    JpegError* err = reinterpret_cast<JpegError*>(cinfo->err);
+    (*cinfo->err->format_message)(cinfo, err->message);
+    longjmp(err->jump, 1);
+}
+
+static void
+outputMessage(j_common_ptr cinfo)
+{
+    char message[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, message);
+    spdlog::debug("JPEG: {}", message);
+}
+
+// One encoded stripe, entropy coded data is data[begin, end)
+struct JpegStripe {
+    std::vector<uint8_t> data;
+    size_t begin = 0;
+    size_t end   = 0;
+    size_t sof   = 0;  // offset of the SOF0 marker
+};
+
+// Finds the SOF0 marker and the end of the SOS header of a libjpeg stream
+static bool
+parseStripe(JpegStripe& stripe)
+{
+    const std::vector<uint8_t>& d = stripe.data;
+    if (d.size() < 4 || d[0] != 0xFF || d[1] != 0xD8 || d[d.size() - 2] != 0xFF || d[d.size() - 1] != 0xD9) {
+        return false;
+    }
+    size_t p = 2;
+    while (p + 4 <= d.size() && d[p] == 0xFF) {
+        uint8_t marker = d[p + 1];
+        size_t length  = (size_t(d[p + 2]) << 8) | d[p + 3];
+        if (marker == 0xC0) {
+            stripe.sof = p;
+        }
+        p += 2 + length;
+        if (marker == 0xDA) {
+            stripe.begin = p;
+            stripe.end   = d.size() - 2;
+            return stripe.sof != 0 && stripe.begin <= stripe.end;
+        }
+    }
+    return false;
+}
+
+// Restart markers of a stripe start at RST0, renumber them to follow the MCU rows above it.
+// Marker bytes cannot appear inside entropy coded data, a literal 0xFF is always stuffed as FF 00.
+static void
+renumberRestarts(JpegStripe& stripe, int firstMcuRow)
+{
+    uint8_t* d = stripe.data.data();
+    int index  = firstMcuRow;
+    for (size_t i = stripe.begin; i + 1 < stripe.end; i++) {
+        if (d[i] == 0xFF && d[i + 1] >= 0xD0 && d[i + 1] <= 0xD7) {
+            d[i + 1] = static_cast<uint8_t>(0xD0 + (index++ & 7));
+            i++;
+        }
+    }
+}
+
+// Encodes pixel rows as a standalone JPEG with a restart marker after every MCU row.
+// Only C objects live past setjmp, libjpeg errors longjmp back here.
+static bool
+encodeStripe(const uint8_t* pixels, int width, int rows, int components, int quality, const std::vector<char>* exif,
+             const ParamValue* icc, JpegStripe& stripe)
+{
+    jpeg_compress_struct cinfo;
+    JpegError jerr;
+
+    cinfo.err               = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit     = errorExit;
+    jerr.pub.output_message = outputMessage;
+    if (setjmp(jerr.jump)) {
+        spdlog::error("JPEG: {}", jerr.message);
+        jpeg_destroy_compress(&cinfo);
+        free(jerr.mem);
+        return false;
+    }
+
+    jpeg_create_compress(&cinfo);
+    jpeg_mem_dest(&cinfo, &jerr.mem, &jerr.length);
+    cinfo.image_width      = width;
+    cinfo.image_height     = rows;
+    cinfo.input_components = components;
+    cinfo.in_color_space   = components == 3 ? JCS_RGB : JCS_GRAYSCALE;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    for (int c = 0; c < cinfo.num_components; c++) {
+        cinfo.comp_info[c].h_samp_factor = 1;
+        cinfo.comp_info[c].v_samp_factor = 1;
+    }
+    // every stripe must use the same standard Huffman tables to be joined
+    cinfo.optimize_coding  = FALSE;
+    cinfo.restart_interval = static_cast<unsigned int>((width + kMcuRows - 1) / kMcuRows);
+    jpeg_start_compress(&cinfo, TRUE);
+
+    if (exif) {
+        jpeg_write_marker(&cinfo, JPEG_APP0 + 1, reinterpret_cast<const JOCTET*>(exif->data()),
+                          static_cast<unsigned int>(exif->size()));
+    }
+    if (icc) {
+        jpeg_write_icc_profile(&cinfo, static_cast<const JOCTET*>(icc->data()),
+                               static_cast<unsigned int>(icc->datasize()));
+    }
+
+    const size_t rowBytes = size_t(width) * components;
+    while (cinfo.next_scanline < cinfo.image_height) {
+        JSAMPROW row = const_cast<JSAMPROW>(pixels + rowBytes * cinfo.next_scanline);
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+
+    stripe.data.assign(jerr.mem, jerr.mem + jerr.length);
+    free(jerr.mem);
+    return true;
+}
+
+bool
+jpegWriteParallel(const ImageBuf& buf, const ImageSpec& spec, int x, int y, const std::string& fileName, int quality,
+                  OutputDigest* digest)
+{
+    const int width  = spec.width;
+    const int height = spec.height;
+    const int nch    = spec.nchannels;
+    if (nch == 2 || nch < 1 || width < 1 || height < 1 || width > 65500 || height > 65500) {
+        return false;
+    }
+    const int components = nch >= 3 ? 3 : 1;
+
+    const int mcuRows    = (height + kMcuRows - 1) / kMcuRows;
+    const int threads    = std::max(1u, std::thread::hardware_concurrency());
+    int stripeMcus       = (mcuRows + threads * kStripesPerThread - 1) / (threads * kStripesPerThread);
+    stripeMcus           = std::max(stripeMcus, kMinStripeRows / kMcuRows);
+    const int stripes    = (mcuRows + stripeMcus - 1) / stripeMcus;
+    const int stripeRows = stripeMcus * kMcuRows;
+
+    std::vector<char> exif = { 'E', 'x', 'i', 'f', 0, 0 };
+    encode_exif(spec, exif);
+    const bool hasExif    = exif.size() > 6 && exif.size() <= 65533;
+    const ParamValue* icc = spec.find_attribute("ICCProfile");
+
+    std::vector<JpegStripe> encoded(stripes);
+    std::atomic<bool> ok { true };
+    parallel_for(int64_t(0), int64_t(stripes), [&](int64_t s) {
+        thread_local std::vector<uint8_t> pixels;
+        const int y0   = int(s) * stripeRows;
+        const int rows = std::min(stripeRows, height - y0);
+        pixels.resize(size_t(width) * rows * components);
+        ROI roi(x, x + width, y + y0, y + y0 + rows, 0, 1, 0, components);
+        if (!buf.get_pixels(roi, TypeDesc::UINT8, pixels.data())) {
+            ok = false;
+            return;
+        }
+        JpegStripe& stripe = encoded[s];
+        if (!encodeStripe(pixels.data(), width, rows, components, quality, s == 0 && hasExif ? &exif : nullptr,
+                          s == 0 ? icc : nullptr, stripe)
+            || !parseStripe(stripe)) {
+            ok = false;
+            return;
+        }
+        renumberRestarts(stripe, int(s) * stripeMcus);
+    });
+    if (!ok) {
+        spdlog::error("JPEG: Cannot encode {}", fileName);
+        return false;
+    }
+
+    // header of the first stripe with the full image height
+    JpegStripe& first = encoded[0];
+    first.data[first.sof + 5] = static_cast<uint8_t>(height >> 8);
+    first.data[first.sof + 6] = static_cast<uint8_t>(height & 0xFF);
+
+#ifdef _WIN32
+    std::u8string u8name(fileName.begin(), fileName.end());
+    std::ofstream file(std::filesystem::path(u8name), std::ios::binary);
+#else
+    std::ofstream file(fileName, std::ios::binary);
+#endif
+    if (!file) {
+        spdlog::error("JPEG: Cannot create {}", fileName);
+        return false;
+    }
+
+    // the file is written strictly in order, so it is hashed on the way out
+    Xxh64 hash;
+    uint64_t fileSize = 0;
+
+    auto put = [&](const void* data, size_t size) {
+        file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        if (digest) {
+            hash.update(data, size);
+        }
+        fileSize += size;
+    };
+
+    size_t written = 0;
+    put(first.data.data(), first.begin);
+    for (int s = 0; s < stripes; s++) {
+        const JpegStripe& stripe = encoded[s];
+        if (s > 0) {
+            // restart marker closing the last MCU row of the previous stripe
+            const uint8_t rst[2] = { 0xFF, uint8_t(0xD0 + ((s * stripeMcus - 1) & 7)) };
+            put(rst, 2);
+        }
+        put(stripe.data.data() + stripe.begin, stripe.end - stripe.begin);
+        written += stripe.end - stripe.begin;
+    }
+    const uint8_t eoi[2] = { 0xFF, 0xD9 };
+    put(eoi, 2);
+    file.close();
+    if (!file) {
+        spdlog::error("JPEG: Cannot write {}", fileName);
+        return false;
+    }
+    if (digest) {
+        digestStreamed(hash, fileSize, *digest);
+    }
+
+    spdlog::debug("JPEG: {} {} stripes of {} rows, {} bytes of entropy coded data", fileName, stripes, stripeRows,
+                  written);
+    return true;
+}
@@ -0,0 +1,39 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#ifndef JPEGWRITER_H
+#    define JPEGWRITER_H
+
+#    include <OpenImageIO/imagebuf.h>
+
+#    include <string>
+
+struct OutputDigest;
+
+// Writes a baseline 4:4:4 JPEG with libjpeg. The image is cut into stripes of whole MCU rows that are
+// encoded concurrently on OIIO's thread pool with a restart marker after every MCU row, the entropy
+// coded stripes are then joined behind one header and the restart markers renumbered.
+// spec gives the written size and metadata (Exif, ICC profile), pixels are read from buf starting at (x, y).
+// Only 1 and 3+ channel images are handled, alpha and extra channels are dropped.
+// digest, if given, is filled from the bytes as they are written.
+bool
+jpegWriteParallel(const OIIO::ImageBuf& buf, const OIIO::ImageSpec& spec, int x, int y, const std::string& fileName,
+                  int quality, OutputDigest* digest = nullptr);
+
+#endif  // !JPEGWRITER_H
@@ -0,0 +1,193 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "pch.h"
+
+#include "jxlwriter.h"
+#include "checksum.h"
+
+#include <OpenImageIO/tiffutils.h>
+
+#include <jxl/encode.h>
+#include <jxl/encode_cxx.h>
+#include <jxl/thread_parallel_runner.h>
+#include <jxl/thread_parallel_runner_cxx.h>
+
+using namespace OIIO;
+
+// libjxl sample type of an output format, formats without a JXL equivalent are stored as uint16
+static JxlDataType
+jxlType(TypeDesc format, TypeDesc& pixel_format, JxlBasicInfo& info)
+{
+    switch (format.basetype) {
+    case TypeDesc::UINT8:
+        pixel_format                  = TypeDesc::UINT8;
+        info.bits_per_sample          = 8;
+        info.exponent_bits_per_sample = 0;
+        return JXL_TYPE_UINT8;
+    case TypeDesc::HALF:
+        pixel_format                  = TypeDesc::HALF;
+        info.bits_per_sample          = 16;
+        info.exponent_bits_per_sample = 5;
+        return JXL_TYPE_FLOAT16;
+    case TypeDesc::FLOAT:
+    case TypeDesc::DOUBLE:
+        pixel_format                  = TypeDesc::FLOAT;
+        info.bits_per_sample          = 32;
+        info.exponent_bits_per_sample = 8;
+        return JXL_TYPE_FLOAT;
+    default:
+        pixel_format                  = TypeDesc::UINT16;
+        info.bits_per_sample          = 16;
+        info.exponent_bits_per_sample = 0;
+        return JXL_TYPE_UINT16;
+    }
+}
+
+static bool
+jxlCheck(JxlEncoderStatus status, const char* what, const std::string& fileName)
+{
+    if (status != JXL_ENC_SUCCESS) {
+        spdlog::error("JXL: {} failed for {}", what, fileName);
+        return false;
+    }
+    return true;
+}
+
+bool
+jxlWrite(const ImageBuf& buf, const ImageSpec& spec, int x, int y, const std::string& fileName, int quality,
+         int effort, int threads, OutputDigest* digest)
+{
+    const int width     = spec.width;
+    const int height    = spec.height;
+    const int nch       = std::min(spec.nchannels, 4);
+    const bool alpha    = nch == 2 || nch == 4;
+    const bool lossless = quality >= 100;
+
+    JxlBasicInfo info;
+    JxlEncoderInitBasicInfo(&info);
+    TypeDesc pixel_format;
+    JxlPixelFormat format = { static_cast<uint32_t>(nch), jxlType(spec.format, pixel_format, info), JXL_NATIVE_ENDIAN,
+                              0 };
+    info.xsize                 = width;
+    info.ysize                 = height;
+    info.num_color_channels    = alpha ? nch - 1 : nch;
+    info.num_extra_channels    = alpha ? 1 : 0;
+    info.alpha_bits            = alpha ? info.bits_per_sample : 0;
+    info.alpha_exponent_bits   = alpha ? info.exponent_bits_per_sample : 0;
+    info.uses_original_profile = lossless ? JXL_TRUE : JXL_FALSE;
+    info.orientation = static_cast<JxlOrientation>(std::clamp(spec.get_int_attribute("Orientation", 1), 1, 8));
+
+    std::vector<uint8_t> pixels(size_t(width) * height * nch * pixel_format.size());
+    if (!buf.get_pixels(ROI(x, x + width, y, y + height, 0, 1, 0, nch), pixel_format, pixels.data())) {
+        spdlog::error("JXL: Cannot read pixels of {}", fileName);
+        return false;
+    }
+
+    auto encoder = JxlEncoderMake(nullptr);
+    auto runner  = JxlThreadParallelRunnerMake(nullptr, static_cast<size_t>(std::max(threads, 1)));
+    if (!jxlCheck(JxlEncoderSetParallelRunner(encoder.get(), JxlThreadParallelRunner, runner.get()), "runner",
+                  fileName)
+        || !jxlCheck(JxlEncoderUseBoxes(encoder.get()), "boxes", fileName)
+        || !jxlCheck(JxlEncoderSetBasicInfo(encoder.get(), &info), "basic info", fileName)) {
+        return false;
+    }
+    if (alpha) {
+        JxlExtraChannelInfo extra;
+        JxlEncoderInitExtraChannelInfo(JXL_CHANNEL_ALPHA, &extra);
+        extra.bits_per_sample          = info.bits_per_sample;
+        extra.exponent_bits_per_sample = info.exponent_bits_per_sample;
+        if (!jxlCheck(JxlEncoderSetExtraChannelInfo(encoder.get(), 0, &extra), "alpha channel", fileName)) {
+            return false;
+        }
+    }
+
+    const ParamValue* icc = spec.find_attribute("ICCProfile");
+    if (icc) {
+        if (!jxlCheck(JxlEncoderSetICCProfile(encoder.get(), static_cast<const uint8_t*>(icc->data()),
+                                              icc->datasize()),
+                      "ICC profile", fileName)) {
+            return false;
+        }
+    } else {
+        JxlColorEncoding color;
+        const JXL_BOOL gray = info.num_color_channels == 1 ? JXL_TRUE : JXL_FALSE;
+        if (pixel_format.is_floating_point()) {
+            JxlColorEncodingSetToLinearSRGB(&color, gray);
+        } else {
+            JxlColorEncodingSetToSRGB(&color, gray);
+        }
+        if (!jxlCheck(JxlEncoderSetColorEncoding(encoder.get(), &color), "color encoding", fileName)) {
+            return false;
+        }
+    }
+
+    // Exif box: 4 byte offset of the TIFF header followed by the TIFF structure
+    std::vector<char> exif = { 0, 0, 0, 0 };
+    encode_exif(spec, exif);
+    if (exif.size() > 4) {
+        jxlCheck(JxlEncoderAddBox(encoder.get(), "Exif", reinterpret_cast<const uint8_t*>(exif.data()), exif.size(),
+                                  JXL_FALSE),
+                 "Exif box", fileName);
+    }
+    JxlEncoderCloseBoxes(encoder.get());
+
+    JxlEncoderFrameSettings* frame = JxlEncoderFrameSettingsCreate(encoder.get(), nullptr);
+    JxlEncoderFrameSettingsSetOption(frame, JXL_ENC_FRAME_SETTING_EFFORT, std::clamp(effort, 1, 9));
+    if (lossless) {
+        JxlEncoderSetFrameLossless(frame, JXL_TRUE);
+    } else {
+        JxlEncoderSetFrameDistance(frame, JxlEncoderDistanceFromQuality(static_cast<float>(quality)));
+    }
+    if (!jxlCheck(JxlEncoderAddImageFrame(frame, &format, pixels.data(), pixels.size()), "frame", fileName)) {
+        return false;
+    }
+    JxlEncoderCloseInput(encoder.get());
+
+    std::vector<uint8_t> out(std::max<size_t>(pixels.size() / 4, 1 << 16));
+    uint8_t* next = out.data();
+    size_t avail  = out.size();
+    JxlEncoderStatus status;
+    while ((status = JxlEncoderProcessOutput(encoder.get(), &next, &avail)) == JXL_ENC_NEED_MORE_OUTPUT) {
+        size_t used = next - out.data();
+        out.resize(out.size() * 2);
+        next  = out.data() + used;
+        avail = out.size() - used;
+    }
+    if (!jxlCheck(status, "encoding", fileName)) {
+        return false;
+    }
+    out.resize(next - out.data());
+
+#ifdef _WIN32
+    std::u8string u8name(fileName.begin(), fileName.end());
+    std::ofstream file(std::filesystem::path(u8name), std::ios::binary);
+#else
+    std::ofstream file(fileName, std::ios::binary);
+#endif
+    file.write(reinterpret_cast<const char*>(out.data()), static_cast<std::streamsize>(out.size()));
+    file.close();
+    if (!file) {
+        spdlog::error("JXL: Cannot write {}", fileName);
+        return false;
+    }
+    if (digest) {
+        digestBuffer(out.data(), out.size(), *digest);
+    }
+    spdlog::debug("JXL: {} effort {} {} threads, {} bytes", fileName, effort, threads, out.size());
+    return true;
+}
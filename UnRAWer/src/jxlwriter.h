@@ -0,0 +1,38 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#ifndef JXLWRITER_H
+#    define JXLWRITER_H
+
+#    include <OpenImageIO/imagebuf.h>
+
+#    include <string>
+
+struct OutputDigest;
+
+// Writes a JPEG XL file with libjxl using a thread parallel runner of exactly `threads` workers.
+// quality 100 is lossless, effort is libjxl's 1 (fastest) - 9 (smallest).
+// uint8/uint16/half/float pixels are passed through, other formats are written as uint16.
+// spec gives the written size and metadata (Exif, ICC profile, orientation), pixels are read from buf at (x, y).
+// digest, if given, is filled from the encoded file before it is written.
+bool
+jxlWrite(const OIIO::ImageBuf& buf, const OIIO::ImageSpec& spec, int x, int y, const std::string& fileName,
+         int quality, int effort, int threads, OutputDigest* digest = nullptr);
+
+#endif  // !JXLWRITER_H
@@ -0,0 +1,375 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "pch.h"
+
+#include "lut3d.h"
+#include "fileProcessor.h"
+
+#include <OpenImageIO/imagebufalgo.h>
+#include <OpenImageIO/imagebufalgo_util.h>
+
+using namespace OIIO;
+
+static constexpr int kMaxLutSize = 256;
+
+bool
+Lut3D::supported(const std::string& path)
+{
+    std::string ext = toLower(std::filesystem::path(path).extension().string());
+    return ext == ".cube" || ext == ".3dl";
+}
+
+bool
+Lut3D::load(const std::string& path)
+{
+    std::ifstream in(path);
+    if (!in) {
+        m_error = "Cannot open " + path;
+        return false;
+    }
+
+    std::string ext = toLower(std::filesystem::path(path).extension().string());
+    bool ok         = ext == ".3dl" ? load3dl(in) : loadCube(in);
+    if (!ok) {
+        if (m_error.empty()) {
+            m_error = "Cannot parse " + path;
+        }
+        m_table.clear();
+        return false;
+    }
+
+    buildTables();
+    return true;
+}
+
+// Adobe/Resolve .cube, data lines are RGB with red changing fastest
+bool
+Lut3D::loadCube(std::istream& in)
+{
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream ls(line);
+        std::string key;
+        if (!(ls >> key) || key[0] == '#') {
+            continue;
+        }
+
+        if (key == "TITLE") {
+            continue;
+        } else if (key == "LUT_1D_SIZE") {
+            m_error = "1D LUTs are not supported";
+            return false;
+        } else if (key == "LUT_3D_SIZE") {
+            ls >> m_size;
+            if (m_size < 2 || m_size > kMaxLutSize) {
+                m_error = "Invalid LUT_3D_SIZE";
+                return false;
+            }
+            m_table.reserve(size_t(m_size) * m_size * m_size * 3);
+        } else if (key == "DOMAIN_MIN") {
+            ls >> m_min[0] >> m_min[1] >> m_min[2];
+        } else if (key == "DOMAIN_MAX") {
+            ls >> m_max[0] >> m_max[1] >> m_max[2];
+        } else if (key == "LUT_3D_INPUT_RANGE") {
+            float lo, hi;
+            if (ls >> lo >> hi) {
+                m_min[0] = m_min[1] = m_min[2] = lo;
+                m_max[0] = m_max[1] = m_max[2] = hi;
+            }
+        } else if (std::isdigit(static_cast<unsigned char>(key[0])) || key[0] == '-' || key[0] == '.') {
+            float r = std::stof(key), g, b;
+            if (!(ls >> g >> b)) {
+                return false;
+            }
+            m_table.push_back(r);
+            m_table.push_back(g);
+            m_table.push_back(b);
+        }
+    }
+    return m_size > 0 && m_table.size() == size_t(m_size) * m_size * m_size * 3;
+}
+
+// Autodesk .3dl, a shaper line with the lattice size, then integer RGB with blue changing fastest
+bool
+Lut3D::load3dl(std::istream& in)
+{
+    std::vector<int> values;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream ls(line);
+        std::vector<int> row;
+        int v;
+        while (ls >> v) {
+            row.push_back(v);
+        }
+        if (row.empty()) {
+            continue;
+        }
+        if (m_size == 0 && row.size() > 3) {
+            m_size = int(row.size());
+            continue;
+        }
+        if (row.size() == 3) {
+            values.insert(values.end(), row.begin(), row.end());
+        }
+    }
+
+    if (m_size < 2 || m_size > kMaxLutSize || values.size() != size_t(m_size) * m_size * m_size * 3) {
+        return false;
+    }
+
+    // output bit depth is not stored, take the smallest common one that fits
+    int max_value = *std::max_element(values.begin(), values.end());
+    float norm    = 1.0f / 65535.0f;
+    for (int bits : { 10, 12, 14, 16 }) {
+        if (max_value < (1 << bits)) {
+            norm = 1.0f / float((1 << bits) - 1);
+            break;
+        }
+    }
+
+    const size_t n = size_t(m_size);
+    m_table.resize(n * n * n * 3);
+    for (size_t i = 0; i < n * n * n; i++) {
+        size_t r = i / (n * n), g = (i / n) % n, b = i % n;
+        size_t o = ((b * n + g) * n + r) * 3;
+        for (int c = 0; c < 3; c++) {
+            m_table[o + c] = values[i * 3 + c] * norm;
+        }
+    }
+    return true;
+}
+
+void
+Lut3D::buildTables()
+{
+    m_last = float(m_size - 1);
+    for (int c = 0; c < 3; c++) {
+        float range = m_max[c] - m_min[c];
+        m_scale[c]  = range > 0.0f ? m_last / range : 0.0f;
+
+        m_pos8[c].resize(256);
+        for (int i = 0; i < 256; i++) {
+            m_pos8[c][i] = position(c, i / 255.0f);
+        }
+        m_pos16[c].resize(65536);
+        for (int i = 0; i < 65536; i++) {
+            m_pos16[c][i] = position(c, i / 65535.0f);
+        }
+    }
+}
+
+void
+Lut3D::lookup(const float* p, float* out) const
+{
+    const int n = m_size;
+    int r0      = std::min(int(p[0]), n - 2);
+    int g0      = std::min(int(p[1]), n - 2);
+    int b0      = std::min(int(p[2]), n - 2);
+    float fr    = p[0] - r0;
+    float fg    = p[1] - g0;
+    float fb    = p[2] - b0;
+
+    const size_t sr = 3;
+    const size_t sg = size_t(n) * 3;
+    const size_t sb = size_t(n) * n * 3;
+
+    const float* c000 = m_table.data() + b0 * sb + g0 * sg + r0 * sr;
+    const float* c111 = c000 + sr + sg + sb;
+    const float *c1, *c2;
+    float w1, w2, w3;
+
+    // pick the tetrahedron by the order of the fractions
+    if (fr > fg) {
+        if (fg > fb) {
+            c1 = c000 + sr, c2 = c1 + sg, w1 = fr, w2 = fg, w3 = fb;
+        } else if (fr > fb) {
+            c1 = c000 + sr, c2 = c1 + sb, w1 = fr, w2 = fb, w3 = fg;
+        } else {
+            c1 = c000 + sb, c2 = c1 + sr, w1 = fb, w2 = fr, w3 = fg;
+        }
+    } else {
+        if (fb > fg) {
+            c1 = c000 + sb, c2 = c1 + sg, w1 = fb, w2 = fg, w3 = fr;
+        } else if (fb > fr) {
+            c1 = c000 + sg, c2 = c1 + sb, w1 = fg, w2 = fb, w3 = fr;
+        } else {
+            c1 = c000 + sg, c2 = c1 + sr, w1 = fg, w2 = fr, w3 = fb;
+        }
+    }
+
+    for (int c = 0; c < 3; c++) {
+        out[c] = c000[c] + w1 * (c1[c] - c000[c]) + w2 * (c2[c] - c1[c]) + w3 * (c111[c] - c2[c]);
+    }
+}
+
+template<typename T>
+static inline float
+loadValue(T v)
+{
+    return float(v);
+}
+
+template<>
+inline float
+loadValue<uint8_t>(uint8_t v)
+{
+    return v * (1.0f / 255.0f);
+}
+
+template<>
+inline float
+loadValue<uint16_t>(uint16_t v)
+{
+    return v * (1.0f / 65535.0f);
+}
+
+template<typename T>
+static inline T
+storeValue(float v)
+{
+    return T(v);
+}
+
+template<>
+inline uint8_t
+storeValue<uint8_t>(float v)
+{
+    return uint8_t(std::clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+template<>
+inline uint16_t
+storeValue<uint16_t>(float v)
+{
+    return uint16_t(std::clamp(v, 0.0f, 1.0f) * 65535.0f + 0.5f);
+}
+
+// Lattice positions of one pixel, integer types go through the precomputed tables
+template<typename S>
+static inline void
+pixelPosition(const Lut3D& lut, const S* s, float* p)
+{
+    for (int c = 0; c < 3; c++) {
+        p[c] = lut.position(c, loadValue<S>(s[c]));
+    }
+}
+
+template<>
+inline void
+pixelPosition<uint8_t>(const Lut3D& lut, const uint8_t* s, float* p)
+{
+    p[0] = lut.pos8(0)[s[0]];
+    p[1] = lut.pos8(1)[s[1]];
+    p[2] = lut.pos8(2)[s[2]];
+}
+
+template<>
+inline void
+pixelPosition<uint16_t>(const Lut3D& lut, const uint16_t* s, float* p)
+{
+    p[0] = lut.pos16(0)[s[0]];
+    p[1] = lut.pos16(1)[s[1]];
+    p[2] = lut.pos16(2)[s[2]];
+}
+
+template<typename S, typename D>
+static void
+applyRows(const Lut3D& lut, const ImageBuf& src, ImageBuf& dst, ROI roi)
+{
+    const int nch = src.nchannels();
+    float p[3], rgb[3];
+
+    for (int y = roi.ybegin; y < roi.yend; y++) {
+        const S* s = static_cast<const S*>(src.pixeladdr(roi.xbegin, y));
+        D* d       = static_cast<D*>(dst.pixeladdr(roi.xbegin, y));
+        for (int x = roi.xbegin; x < roi.xend; x++, s += nch, d += nch) {
+            pixelPosition<S>(lut, s, p);
+            lut.lookup(p, rgb);
+            d[0] = storeValue<D>(rgb[0]);
+            d[1] = storeValue<D>(rgb[1]);
+            d[2] = storeValue<D>(rgb[2]);
+            for (int c = 3; c < nch; c++) {
+                d[c] = storeValue<D>(loadValue<S>(s[c]));
+            }
+        }
+    }
+}
+
+template<typename S>
+static bool
+applyTo(const Lut3D& lut, const ImageBuf& src, ImageBuf& dst, ROI roi)
+{
+    switch (dst.spec().format.basetype) {
+    case TypeDesc::UINT8: applyRows<S, uint8_t>(lut, src, dst, roi); return true;
+    case TypeDesc::UINT16: applyRows<S, uint16_t>(lut, src, dst, roi); return true;
+    case TypeDesc::HALF: applyRows<S, half>(lut, src, dst, roi); return true;
+    case TypeDesc::FLOAT: applyRows<S, float>(lut, src, dst, roi); return true;
+    default: return false;
+    }
+}
+
+static bool
+nativeType(TypeDesc format)
+{
+    return format.basetype == TypeDesc::UINT8 || format.basetype == TypeDesc::UINT16
+           || format.basetype == TypeDesc::HALF || format.basetype == TypeDesc::FLOAT;
+}
+
+bool
+Lut3D::apply(ImageBuf& dst, const ImageBuf& src, int nthreads) const
+{
+    if (m_table.empty() || src.nchannels() < 3) {
+        return false;
+    }
+
+    // other pixel types go through a float copy
+    if (!nativeType(src.spec().format)) {
+        ImageBuf float_src;
+        return ImageBufAlgo::copy(float_src, src, TypeDesc::FLOAT) && apply(dst, float_src, nthreads);
+    }
+
+    if (!dst.initialized()) {
+        dst.reset(src.spec(), InitializePixels::No);
+    }
+    if (dst.nchannels() != src.nchannels() || dst.spec().width != src.spec().width
+        || dst.spec().height != src.spec().height) {
+        return false;
+    }
+    if (!nativeType(dst.spec().format)) {
+        ImageBuf float_dst(ImageSpec(src.spec().width, src.spec().height, src.nchannels(), TypeDesc::FLOAT),
+                           InitializePixels::No);
+        return apply(float_dst, src, nthreads) && dst.copy_pixels(float_dst);
+    }
+
+    std::atomic<bool> ok { true };
+    ImageBufAlgo::parallel_image(src.roi(), paropt(nthreads), [&](ROI roi) {
+        bool done = false;
+        switch (src.spec().format.basetype) {
+        case TypeDesc::UINT8: done = applyTo<uint8_t>(*this, src, dst, roi); break;
+        case TypeDesc::UINT16: done = applyTo<uint16_t>(*this, src, dst, roi); break;
+        case TypeDesc::HALF: done = applyTo<half>(*this, src, dst, roi); break;
+        case TypeDesc::FLOAT: done = applyTo<float>(*this, src, dst, roi); break;
+        default: break;
+        }
+        if (!done) {
+            ok = false;
+        }
+    });
+    return ok;
+}
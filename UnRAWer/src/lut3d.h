@@ -0,0 +1,74 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#ifndef LUT3D_H
+#    define LUT3D_H
+
+#    include <OpenImageIO/imagebuf.h>
+
+#    include <string>
+#    include <vector>
+
+// Native 3D LUT (.cube / .3dl) with tetrahedral interpolation.
+// Integer pixels are mapped to lattice positions through precomputed tables and the result is stored
+// straight into the destination type, so uint8/uint16 images skip the float image round trip.
+class Lut3D {
+public:
+    // true if the file extension is one of the supported LUT formats
+    static bool supported(const std::string& path);
+
+    bool load(const std::string& path);
+
+    // Applies the LUT to the first three channels of src, other channels are copied.
+    // dst is allocated with src's spec if it is not initialized, otherwise its format is kept.
+    bool apply(OIIO::ImageBuf& dst, const OIIO::ImageBuf& src, int nthreads = 0) const;
+
+    int size() const { return m_size; }
+    const std::string& error() const { return m_error; }
+
+    // Lattice position of a normalized channel value
+    float position(int c, float v) const
+    {
+        float p = (v - m_min[c]) * m_scale[c];
+        return p < 0.0f ? 0.0f : (p > m_last ? m_last : p);
+    }
+
+    const float* pos8(int c) const { return m_pos8[c].data(); }
+    const float* pos16(int c) const { return m_pos16[c].data(); }
+
+    // Tetrahedral interpolation at lattice position p, out is RGB
+    void lookup(const float* p, float* out) const;
+
+private:
+    bool loadCube(std::istream& in);
+    bool load3dl(std::istream& in);
+    void buildTables();
+
+    int m_size     = 0;
+    float m_last   = 0.0f;  // m_size - 1
+    float m_min[3] = { 0.0f, 0.0f, 0.0f };
+    float m_max[3] = { 1.0f, 1.0f, 1.0f };
+    float m_scale[3];
+    std::vector<float> m_table;  // RGB triplets, red changes fastest
+    std::vector<float> m_pos8[3];
+    std::vector<float> m_pos16[3];
+    std::string m_error;
+};
+
+#endif  // !LUT3D_H
@@ -0,0 +1,128 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "pch.h"
+
+#include "lutregistry.h"
+#include "settings.h"
+#include "Timer.h"
+
+void
+LutRegistry::init(const OIIO::ColorConfig* config, const std::vector<std::string>& prewarm)
+{
+    m_config = config;
+    m_entries.clear();
+    {
+        std::unique_lock<std::shared_mutex> lock(m_cameraMutex);
+        m_cameraLuts.clear();
+    }
+    for (const auto& [name, path] : settings.lut_Preset) {
+        auto entry  = std::make_unique<Entry>();
+        entry->path = path;
+        m_entries.emplace(name, std::move(entry));
+    }
+
+    mTimer timer;
+    int warmed = 0;
+    for (const auto& name : prewarm) {
+        const Entry* entry = load(name);
+        if (entry && (entry->processor || entry->lut3d)) {
+            warmed++;
+        }
+    }
+    spdlog::debug("LUT registry: {} LUTs, {} prewarmed in {}", m_entries.size(), warmed, timer.nowText());
+}
+
+const LutRegistry::Entry*
+LutRegistry::load(const std::string& name) const
+{
+    auto it = m_entries.find(name);
+    if (it == m_entries.end()) {
+        return nullptr;
+    }
+
+    Entry& entry = *it->second;
+    std::call_once(entry.once, [&]() {
+        if (settings.lutEngine == 1 && Lut3D::supported(entry.path)) {
+            auto lut3d = std::make_shared<Lut3D>();
+            if (lut3d->load(entry.path)) {
+                spdlog::debug("LUT registry: {} <{}> loaded, native {}^3", name, entry.path, lut3d->size());
+                entry.lut3d = std::move(lut3d);
+                return;
+            }
+            spdlog::warn("LUT registry: {}, using OCIO for {}", lut3d->error(), name);
+        }
+        if (m_config) {
+            entry.processor = m_config->createFileTransform(entry.path);
+        }
+        if (entry.processor) {
+            spdlog::debug("LUT registry: {} <{}> loaded", name, entry.path);
+        } else {
+            spdlog::error("LUT registry: Cannot load {} <{}>", name, entry.path);
+        }
+    });
+    return &entry;
+}
+
+OIIO::ColorProcessorHandle
+LutRegistry::get(const std::string& name) const
+{
+    const Entry* entry = load(name);
+    return entry ? entry->processor : nullptr;
+}
+
+std::shared_ptr<const Lut3D>
+LutRegistry::getNative(const std::string& name) const
+{
+    const Entry* entry = load(name);
+    return entry ? entry->lut3d : nullptr;
+}
+
+std::optional<std::string>
+LutRegistry::cameraLut(const std::string& preset, const std::string& make, const std::string& model) const
+{
+    const std::string key = preset + "|" + make + "|" + model;
+    {
+        std::shared_lock<std::shared_mutex> lock(m_cameraMutex);
+        auto it = m_cameraLuts.find(key);
+        if (it != m_cameraLuts.end()) {
+            return it->second;
+        }
+    }
+
+    std::optional<std::string> resolved;
+    std::string name = preset + "_" + make + "_" + model;
+    if (contains(name)) {
+        resolved = name;
+    } else if (auto it = m_entries.find(preset); it != m_entries.end()) {
+        // not scanned with the LUT folder, still usable through the file transform
+        std::filesystem::path path(it->second->path);
+        std::filesystem::path camera = path.parent_path() / (name + path.extension().string());
+        std::error_code ec;
+        if (std::filesystem::exists(camera, ec)) {
+            resolved = name;
+        }
+    }
+    if (resolved) {
+        spdlog::debug("LUT registry: {} {} {} uses {}", preset, make, model, *resolved);
+    } else {
+        spdlog::warn("LUT registry: No {} LUT for {} {}", preset, make, model);
+    }
+
+    std::unique_lock<std::shared_mutex> lock(m_cameraMutex);
+    return m_cameraLuts.emplace(key, resolved).first->second;
+}
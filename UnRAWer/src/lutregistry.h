@@ -0,0 +1,74 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#ifndef LUTREGISTRY_H
+#    define LUTREGISTRY_H
+
+#    include "lut3d.h"
+
+#    include <OpenImageIO/color.h>
+
+#    include <memory>
+#    include <mutex>
+#    include <optional>
+#    include <shared_mutex>
+#    include <string>
+#    include <unordered_map>
+#    include <vector>
+
+// LUT processors shared by all files of a batch, keyed by LUT name (preset or per camera file stem).
+// The map is filled once at batch start from settings.lut_Preset and is read only afterwards;
+// each processor is built on first use (or prewarmed), so lookups take no lock.
+// With the native engine .cube/.3dl files are loaded as Lut3D tables, other files use OCIO.
+class LutRegistry {
+public:
+    // Rebuilds the registry for the current LUT folder, prewarm names are built right away
+    void init(const OIIO::ColorConfig* config, const std::vector<std::string>& prewarm);
+
+    // Ready to apply processor, nullptr if the LUT is unknown, cannot be loaded or is a native LUT
+    OIIO::ColorProcessorHandle get(const std::string& name) const;
+
+    // Native LUT table, nullptr if the LUT is unknown or handled by OCIO
+    std::shared_ptr<const Lut3D> getNative(const std::string& name) const;
+
+    bool contains(const std::string& name) const { return m_entries.find(name) != m_entries.end(); }
+
+    // Name of a preset's per camera LUT (preset_make_model), resolved once per camera and cached.
+    // std::nullopt if the camera has no LUT file.
+    std::optional<std::string> cameraLut(const std::string& preset, const std::string& make,
+                                         const std::string& model) const;
+
+private:
+    struct Entry {
+        std::string path;
+        std::once_flag once;
+        OIIO::ColorProcessorHandle processor;
+        std::shared_ptr<const Lut3D> lut3d;
+    };
+
+    const Entry* load(const std::string& name) const;
+
+    const OIIO::ColorConfig* m_config = nullptr;
+    std::unordered_map<std::string, std::unique_ptr<Entry>> m_entries;
+
+    mutable std::shared_mutex m_cameraMutex;
+    mutable std::unordered_map<std::string, std::optional<std::string>> m_cameraLuts;  // preset|make|model
+};
+
+#endif  // !LUTREGISTRY_H
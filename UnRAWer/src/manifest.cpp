@@ -0,0 +1,100 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "pch.h"
+
+#include "manifest.h"
+#include "settings.h"
+
+#include <OpenImageIO/sysutil.h>
+
+namespace fs = std::filesystem;
+
+static std::mutex manifestMutex;
+static std::string batchStart;
+
+static std::string
+jsonString(const std::string& text)
+{
+    std::string out = "\"";
+    for (char c : text) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[7];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out += escaped;
+            } else {
+                out += c;
+            }
+        }
+    }
+    return out + "\"";
+}
+
+void
+manifestBegin()
+{
+    std::time_t now = std::time(nullptr);
+    struct tm m_tm;
+    OIIO::Sysutil::get_local_time(&now, &m_tm);
+    char datetime[20];
+    strftime(datetime, sizeof(datetime), "%Y-%m-%dT%H:%M:%S", &m_tm);
+
+    std::lock_guard<std::mutex> lock(manifestMutex);
+    batchStart = datetime;
+}
+
+void
+manifestAdd(const std::string& source, const std::string& output, const OutputDigest& digest)
+{
+#ifdef _WIN32
+    std::u8string u8name(output.begin(), output.end());
+    fs::path outPath(u8name);
+    std::u8string u8manifest(settings.manifest.begin(), settings.manifest.end());
+    fs::path manifest(u8manifest);
+#else
+    fs::path outPath(output);
+    fs::path manifest(settings.manifest);
+#endif
+    if (manifest.is_relative()) {
+        manifest = outPath.parent_path() / manifest;
+    }
+
+    char seconds[32];
+    std::snprintf(seconds, sizeof(seconds), "%.3f", digest.seconds);
+    std::string line = "{\"batch\":" + jsonString(batchStart) + ",\"source\":" + jsonString(source)
+                       + ",\"output\":" + jsonString(output) + ",\"size\":" + std::to_string(digest.size)
+                       + ",\"xxh64\":\"" + digestText(digest.xxh64) + "\",\"hashed\":\""
+                       + (digest.streamed ? "stream" : "readback") + "\",\"encode_s\":" + seconds + "}\n";
+
+    std::lock_guard<std::mutex> lock(manifestMutex);
+    std::ofstream file(manifest, std::ios::binary | std::ios::app);
+    if (!file) {
+        spdlog::error("Manifest: Cannot open {}", manifest.string());
+        return;
+    }
+    file << line;
+    if (!file) {
+        spdlog::error("Manifest: Cannot write {}", manifest.string());
+    }
+}
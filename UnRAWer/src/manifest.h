@@ -0,0 +1,36 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#ifndef MANIFEST_H
+#    define MANIFEST_H
+
+#    include "checksum.h"
+
+#    include <string>
+
+// Starts a batch, its start time tags the following manifest entries
+void
+manifestBegin();
+
+// Appends a JSON line with the source, output, size, checksum and encode time of a written file to the manifest.
+// A relative Export.Manifest name is kept next to the output, an absolute path collects the whole batch.
+void
+manifestAdd(const std::string& source, const std::string& output, const OutputDigest& digest);
+
+#endif  // !MANIFEST_H
@@ -0,0 +1,169 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "pch.h"
+
+#include "presetmatcher.h"
+
+#include <cctype>
+#include <filesystem>
+#include <mutex>
+#include <queue>
+
+namespace fs = std::filesystem;
+
+static inline uint8_t
+foldCase(unsigned char c)
+{
+    return static_cast<uint8_t>(std::tolower(c));
+}
+
+void
+PresetMatcher::init(const std::map<std::string, std::string>& presets)
+{
+    m_patterns.clear();
+    m_lengths.clear();
+    m_next.clear();
+    m_best.clear();
+    std::fill(std::begin(m_classes), std::end(m_classes), uint8_t(0));
+    m_alphabet = 1;
+    {
+        std::unique_lock<std::shared_mutex> lock(m_memoMutex);
+        m_folderMemo.clear();
+    }
+
+    for (const auto& preset : presets) {
+        if (preset.first.empty()) {
+            continue;
+        }
+        m_patterns.push_back(preset.first);
+        m_lengths.push_back(preset.first.size());
+        for (unsigned char c : preset.first) {
+            uint8_t f = foldCase(c);
+            if (m_classes[f] == 0) {
+                m_classes[f] = static_cast<uint8_t>(m_alphabet++);
+            }
+        }
+    }
+    // upper case bytes share the class of their lower case form
+    for (int c = 0; c < 256; c++) {
+        m_classes[c] = m_classes[foldCase(static_cast<unsigned char>(c))];
+    }
+
+    // trie, node 0 is the root
+    std::vector<int> trie(m_alphabet, -1);
+    m_best.push_back(-1);
+    for (int p = 0; p < static_cast<int>(m_patterns.size()); p++) {
+        int node = 0;
+        for (unsigned char c : m_patterns[p]) {
+            int& next = trie[node * m_alphabet + m_classes[c]];
+            if (next < 0) {
+                next = static_cast<int>(m_best.size());
+                m_best.push_back(-1);
+                trie.resize(trie.size() + m_alphabet, -1);
+            }
+            node = trie[node * m_alphabet + m_classes[c]];
+        }
+        // presets differing only in case: the first one in map order is kept
+        if (m_best[node] < 0) {
+            m_best[node] = p;
+        }
+    }
+
+    // breadth first: failure links turn the trie into a DFA, and a node without its own preset
+    // reports the longest one of its failure chain
+    m_next = trie;
+    std::vector<int> fail(m_best.size(), 0);
+    std::queue<int> queue;
+    for (int a = 0; a < m_alphabet; a++) {
+        int& next = m_next[a];
+        if (next < 0) {
+            next = 0;
+        } else {
+            queue.push(next);
+        }
+    }
+    while (!queue.empty()) {
+        int node = queue.front();
+        queue.pop();
+        if (m_best[node] < 0) {
+            m_best[node] = m_best[fail[node]];
+        }
+        for (int a = 0; a < m_alphabet; a++) {
+            int& next = m_next[node * m_alphabet + a];
+            int via   = m_next[fail[node] * m_alphabet + a];
+            if (next < 0) {
+                next = via;
+            } else {
+                fail[next] = via;
+                queue.push(next);
+            }
+        }
+    }
+
+    spdlog::debug("Preset matcher: {} presets, {} states, {} symbols", m_patterns.size(), m_best.size(),
+                  m_alphabet);
+}
+
+PresetMatcher::Hit
+PresetMatcher::scan(const std::string& text) const
+{
+    Hit hit;
+    if (m_patterns.empty()) {
+        return hit;
+    }
+    int node = 0;
+    for (unsigned char c : text) {
+        node  = m_next[node * m_alphabet + m_classes[c]];
+        int p = m_best[node];
+        if (p >= 0 && (m_lengths[p] > hit.length || (m_lengths[p] == hit.length && p < hit.pattern))) {
+            hit.pattern = p;
+            hit.length  = m_lengths[p];
+        }
+    }
+    return hit;
+}
+
+std::optional<std::string>
+PresetMatcher::match(const std::string& fileName) const
+{
+    fs::path p(fileName);
+    std::string folder = p.parent_path().string();
+
+    Hit folderHit;
+    bool cached = false;
+    {
+        std::shared_lock<std::shared_mutex> lock(m_memoMutex);
+        auto it = m_folderMemo.find(folder);
+        if (it != m_folderMemo.end()) {
+            folderHit = it->second;
+            cached    = true;
+        }
+    }
+    if (!cached) {
+        folderHit = scan(folder);
+        std::unique_lock<std::shared_mutex> lock(m_memoMutex);
+        m_folderMemo.emplace(folder, folderHit);
+    }
+
+    Hit nameHit = scan(p.stem().string());
+    Hit best    = nameHit.length >= folderHit.length ? nameHit : folderHit;
+    if (best.pattern < 0) {
+        return std::nullopt;
+    }
+    return m_patterns[best.pattern];
+}
@@ -0,0 +1,61 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#ifndef PRESETMATCHER_H
+#    define PRESETMATCHER_H
+
+#    include <map>
+#    include <optional>
+#    include <shared_mutex>
+#    include <string>
+#    include <unordered_map>
+#    include <vector>
+
+// Finds the LUT preset named in a file path.
+// Preset names are compiled into a case insensitive Aho-Corasick automaton, so a name is scanned once
+// whatever the number of presets. The longest preset found wins; on equal length the one found in the
+// base name wins over the folder, then the alphabetically first preset. Folder results are memoised.
+class PresetMatcher {
+public:
+    // Rebuilds the automaton from the preset map (preset name -> LUT file)
+    void init(const std::map<std::string, std::string>& presets);
+
+    // Preset for "parent/basename", std::nullopt if no preset name is found
+    std::optional<std::string> match(const std::string& fileName) const;
+
+private:
+    struct Hit {
+        int pattern = -1;
+        size_t length = 0;
+    };
+
+    Hit scan(const std::string& text) const;
+
+    std::vector<std::string> m_patterns;  // preset names, map order
+    std::vector<size_t> m_lengths;
+    uint8_t m_classes[256] = {};  // byte -> alphabet class, 0 for bytes not used by any preset
+    int m_alphabet         = 1;
+    std::vector<int> m_next;  // DFA transitions, node * m_alphabet + class
+    std::vector<int> m_best;  // longest pattern ending at a node, -1 if none
+
+    mutable std::shared_mutex m_memoMutex;
+    mutable std::unordered_map<std::string, Hit> m_folderMemo;
+};
+
+#endif  // !PRESETMATCHER_H
@@ -33,6 +33,14 @@ MakeThumbnailRGBA16F(const std::string& file_path, int target_square_size, Previ
         return false;
     }
 
+    // outputs written with orientation metadata are shown upright
+    if (src.spec().get_int_attribute("Orientation", 1) != 1) {
+        OIIO::ImageBuf upright;
+        if (OIIO::ImageBufAlgo::reorient(upright, src)) {
+            src.swap(upright);
+        }
+    }
+
     const int src_w = src.spec().width;
     const int src_h = src.spec().height;
     if (src_w <= 0 || src_h <= 0) {
@@ -19,7 +19,15 @@
 
 #include "processors.h"
 #include "exif_parser.h"
+#include "manifest.h"
+#include "pyramid.h"
+#include "rawcache.h"
+#include "rangeconv.h"
+#include "rawconvert.h"
 #include "settings.h"
+#include "sharpen.h"
+#include "tiledproc.h"
+#include "Timer.h"
 
 namespace fs = std::filesystem;
 
@@ -27,6 +35,35 @@ namespace fs = std::filesystem;
 
 OutPaths outpaths;
 
+// Fused output conversion replaces LibRaw's dcraw_make_mem_image() and the copy of its memory image
+static bool
+useFusedConvert()
+{
+    return settings.fusedConvert && settings.dDemosaic > -1;
+}
+
+// Rotation is written as the Exif Orientation tag, LibRaw's own writers only know physical rotation
+static bool
+useOrientMeta()
+{
+    return settings.orientMeta && (settings.dDemosaic > -1 || settings.proxyMode);
+}
+
+// Sets LibRaw's flip, with orientation metadata the pixels stay in sensor orientation
+static void
+setFlip(std::unique_ptr<ProcessingParams>& processing)
+{
+    auto& raw = processing->raw_data;
+    if (useOrientMeta()) {
+        int flip = settings.rawRot >= 0 ? settings.rawRot : raw->imgdata.sizes.flip;
+        // LibRaw flip to Exif Orientation, same table as LibRaw's tiff writer
+        processing->orientation       = "12435867"[flip & 7] - '0';
+        raw->imgdata.params.user_flip = 0;
+    } else {
+        raw->imgdata.params.user_flip = settings.rawRot;
+    }
+}
+
 bool
 isRaw(const std::string& file, const std::unordered_set<std::string>& raw_ext_set)
 {
@@ -193,7 +230,7 @@ Sorter(int index, std::string fileName, std::unique_ptr<ProcessingParams>& proce
     std::string prest_sfx                              = "";
     auto [path, parentFolderName, baseName, extension] = splitPath(fileName);
 
-    std::optional<std::string> lut_preset = getPresetfromName(parentFolderName + "/" + baseName, &settings);
+    std::optional<std::string> lut_preset = getPresetfromName(parentFolderName + "/" + baseName);
     if (lut_preset.has_value()) {
         prest_sfx = lut_preset.value();
     } else {
@@ -232,6 +269,36 @@ Sorter(int index, std::string fileName, std::unique_ptr<ProcessingParams>& proce
     processing->outFile    = outName;
     processing->outExt     = outExt;
     processing->lut_preset = lut_preset.value_or("");
+
+    for (size_t v = 0; v < settings.variants.size() && !settings.proxyMode; v++) {
+        const auto& variant = settings.variants[v];
+
+        VariantOutput out;
+        out.variant    = v;
+        out.fileFormat = variant.fileFormat != -1 ? variant.fileFormat : settings.fileFormat;
+        out.outFile    = outName + variant.suffix;
+        out.outExt     = getFormatExt(out.fileFormat, &settings);
+        if (variant.lutPreset == "") {
+            out.lut_preset = processing->lut_preset;
+        } else if (variant.lutPreset != "none") {
+            if (settings.lut_Preset.find(variant.lutPreset) != settings.lut_Preset.end()) {
+                out.lut_preset = variant.lutPreset;
+            } else {
+                spdlog::error("PRE: Variant {} LUT preset {} not found", variant.suffix, variant.lutPreset);
+            }
+        }
+        spdlog::debug("PRE: Variant {}{} LUT: {}", out.outFile, out.outExt, out.lut_preset);
+        processing->variants.push_back(std::move(out));
+    }
+    for (int format : settings.extraFormats) {
+        if (settings.proxyMode || format < 0 || format > 8 || getFormatExt(format, &settings) == outExt
+            || std::find(processing->extraFormats.begin(), processing->extraFormats.end(), format)
+                   != processing->extraFormats.end()) {
+            continue;
+        }
+        spdlog::debug("PRE: Extra format {}{}", outName, getFormatExt(format, &settings));
+        processing->extraFormats.push_back(format);
+    }
     spdlog::debug("PRE: Preprocessing file {} > {}/{}{}", processing->srcFile, outpaths.get_path(path_idx),
                   processing->outFile, processing->outExt);
 
@@ -286,6 +353,41 @@ Reader(int index, std::unique_ptr<ProcessingParams>& processing_entry, std::atom
                                     myPools);
 }
 
+// Per camera LUTs are resolved before anything is decoded, a camera without a LUT file takes the
+// exif_lut_fallback path. Returns false if the file has to be skipped.
+static bool
+checkCameraLuts(std::unique_ptr<ProcessingParams>& processing)
+{
+    if (!settings.perCamera || settings.lutMode < 0) {
+        return true;
+    }
+    const auto& make  = processing->m_exif.make;
+    const auto& model = processing->m_exif.model;
+    auto& registry    = procGlobals.lut_registry;
+
+    if (!processing->lut_preset.empty() && !registry.cameraLut(processing->lut_preset, make, model)) {
+        switch (settings.cameraLutFallback) {
+        case 1:
+            spdlog::warn("Reader: No {} LUT for {} {}, LUT skipped: {}", processing->lut_preset, make, model,
+                         processing->srcFile);
+            processing->lut_preset.clear();
+            break;
+        case 2:
+            spdlog::error("Reader: No {} LUT for {} {}, file skipped: {}", processing->lut_preset, make, model,
+                          processing->srcFile);
+            return false;
+        default: break;  // the preset LUT itself, see lutName()
+        }
+    }
+    for (auto& variant : processing->variants) {
+        if (settings.cameraLutFallback == 1 && !variant.lut_preset.empty()
+            && !registry.cameraLut(variant.lut_preset, make, model)) {
+            variant.lut_preset.clear();
+        }
+    }
+    return true;
+}
+
 // Libraw disk reader
 void
 rawReader(int index, std::unique_ptr<ProcessingParams>& processing_entry, std::atomic_size_t* fileCntr,
@@ -304,7 +406,7 @@ rawReader(int index, std::unique_ptr<ProcessingParams>& processing_entry, std::a
         }
     }
 
-    processing->raw_data = std::make_unique<LibRaw>();
+    processing->raw_data = std::make_unique<FusedLibRaw>();
     LibRaw* raw          = processing->raw_data.get();
 
     spdlog::info("Libraw Reader: file {}", processing->srcFile);
@@ -320,8 +422,18 @@ rawReader(int index, std::unique_ptr<ProcessingParams>& processing_entry, std::a
     processing->m_exif.make  = processing->raw_data->imgdata.idata.make;
     processing->m_exif.model = processing->raw_data->imgdata.idata.model;
 
+    if (!checkCameraLuts(processing)) {
+        processing->raw_data.reset();
+        processing->setStatus(ProcessingStatus::Failed);
+        return;
+    }
+
     (*fileCntr)--;
-    (*myPools)["LUnpacker"]->enqueue(LUnpacker, index, std::ref(processing_entry), fileCntr, myPools);
+    if (settings.proxyMode) {
+        (*myPools)["LUnpacker"]->enqueue(Proxy, index, std::ref(processing_entry), fileCntr, myPools);
+    } else {
+        (*myPools)["LUnpacker"]->enqueue(LUnpacker, index, std::ref(processing_entry), fileCntr, myPools);
+    }
 }
 
 // Libraw disk unpacker
@@ -345,9 +457,9 @@ LUnpacker(int index, std::unique_ptr<ProcessingParams>& processing_entry, std::a
 
     raw->imgdata.params.output_color = settings.rawSpace;
 
-    raw->imgdata.params.user_flip = settings.rawRot;
+    setFlip(processing);
 
-    spdlog::trace("Unpack: CameraRaw Rotations: {}", settings.rawRot);
+    spdlog::trace("Unpack: CameraRaw Rotations: {} Exif Orientation: {}", settings.rawRot, processing->orientation);
 
     if (settings.denoise_mode == 1 || settings.denoise_mode == 3) {
         raw->imgdata.params.threshold = settings.rawParms.denoise_thr;
@@ -361,13 +473,18 @@ LUnpacker(int index, std::unique_ptr<ProcessingParams>& processing_entry, std::a
         raw->imgdata.params.fbdd_noiserd = 0;
     }
 
-    int ret = raw->unpack();
-    if (ret != LIBRAW_SUCCESS) {
-        spdlog::error("Unpack: Cannot unpack data from file: {}", processing->srcFile);
-        return;
+    int ret;
+    if (!settings.rawCache || !rawCacheLoad(raw.get(), processing->srcFile)) {
+        ret = raw->unpack();
+        if (ret != LIBRAW_SUCCESS) {
+            spdlog::error("Unpack: Cannot unpack data from file: {}", processing->srcFile);
+            return;
+        }
+        if (settings.rawCache) {
+            rawCacheStore(raw.get(), processing->srcFile);
+        }
     }
 
-
     if (settings.crop_mode != -1) {
         if (raw->imgdata.sizes.raw_inset_crops->cwidth != 0 && raw->imgdata.sizes.raw_inset_crops->cheight != 0) {
             if (raw->imgdata.sizes.raw_inset_crops->cwidth <= raw->imgdata.rawdata.sizes.raw_width
@@ -402,6 +519,101 @@ LUnpacker(int index, std::unique_ptr<ProcessingParams>& processing_entry, std::a
     }
 }
 
+// Embedded preview instead of unpack and demosaic, rotation and crop are applied to the preview
+void
+Proxy(int index, std::unique_ptr<ProcessingParams>& processing_entry, std::atomic_size_t* fileCntr,
+      std::map<std::string, std::unique_ptr<ThreadPool>>* myPools)
+{
+    auto& processing = processing_entry;
+    spdlog::info("Proxy: file {}", processing->srcFile);
+
+    auto& raw = processing->raw_data;
+
+    setFlip(processing);
+
+    int ret = raw->adjust_sizes_info_only();
+    if (ret != LIBRAW_SUCCESS) {
+        spdlog::error("Proxy: Cannot adjust sizes info: {}", processing->srcFile);
+        processing->setStatus(ProcessingStatus::Failed);
+        return;
+    }
+
+    ImageBuf thumb_buf;
+    if (!thumb_load(*raw, thumb_buf)) {
+        spdlog::error("Proxy: No usable embedded preview in file: {}", processing->srcFile);
+        processing->setStatus(ProcessingStatus::Failed);
+        return;
+    }
+
+    // previews are stored in sensor orientation
+    const int flip = raw->imgdata.sizes.flip;
+    auto image     = std::make_unique<ImageBuf>();
+    bool rot_ok    = true;
+    switch (flip) {
+    case 3: rot_ok = ImageBufAlgo::rotate180(*image, thumb_buf); break;
+    case 5: rot_ok = ImageBufAlgo::rotate270(*image, thumb_buf); break;
+    case 6: rot_ok = ImageBufAlgo::rotate90(*image, thumb_buf); break;
+    default: image->swap(thumb_buf); break;
+    }
+    if (!rot_ok) {
+        spdlog::error("Proxy: Cannot rotate preview: {}", image->geterror());
+        processing->setStatus(ProcessingStatus::Failed);
+        return;
+    }
+
+    int pv_width  = image->spec().width;
+    int pv_height = image->spec().height;
+    spdlog::debug("Proxy: Preview {}x{} orientation {}", pv_width, pv_height, flip);
+
+    // raw crops are scaled to the preview, unless the preview frame is already cropped in camera
+    setCrops(index, processing_entry);
+    int full_width  = (flip & 4) ? raw->imgdata.sizes.height : raw->imgdata.sizes.width;
+    int full_height = (flip & 4) ? raw->imgdata.sizes.width : raw->imgdata.sizes.height;
+    float scale_x   = full_width > 0 ? pv_width / float(full_width) : 0.0f;
+    float scale_y   = full_height > 0 ? pv_height / float(full_height) : 0.0f;
+    bool full_frame = scale_x > 0.0f && std::abs(scale_x - scale_y) < 0.01f * std::max(scale_x, scale_y);
+
+    auto& crops = processing->m_crops;
+    if (settings.crop_mode != -1 && full_frame) {
+        crops.left   = std::clamp(int(crops.left * scale_x + 0.5f), 0, pv_width - 1);
+        crops.top    = std::clamp(int(crops.top * scale_y + 0.5f), 0, pv_height - 1);
+        crops.width  = std::clamp(int(crops.width * scale_x + 0.5f), 1, pv_width - crops.left);
+        crops.height = std::clamp(int(crops.height * scale_y + 0.5f), 1, pv_height - crops.top);
+    } else {
+        crops.left   = 0;
+        crops.top    = 0;
+        crops.width  = pv_width;
+        crops.height = pv_height;
+    }
+
+    TypeDesc out_format = settings.bitDepth != -1 ? getTypeDesc(settings.bitDepth) : image->spec().format;
+    RangeMap range      = rangeMap(settings.rangeMode);
+    if (out_format != image->spec().format || range.active()) {
+        auto conv_buf = std::make_unique<ImageBuf>();
+        if (!convertRange(*conv_buf, *image, out_format, range)) {
+            spdlog::error("Proxy: Cannot convert preview: {}", conv_buf->geterror());
+            processing->setStatus(ProcessingStatus::Failed);
+            return;
+        }
+        image = std::move(conv_buf);
+    }
+
+    processing->outSpec = std::make_unique<ImageSpec>(image->spec());
+    EXIF::get_exif(processing->raw_data, *processing->outSpec);
+    if (processing->orientation != 1) {
+        processing->outSpec->attribute("Orientation", processing->orientation);
+    }
+
+    processing->image      = std::move(image);
+    processing->raw_image  = nullptr;
+    processing->rawCleared = true;
+
+    processing->setStatus(ProcessingStatus::Unpacked);
+
+    (*fileCntr) -= 4;
+    (*myPools)["writer"]->enqueue(Writer, index, std::ref(processing_entry), fileCntr, myPools);
+}
+
 // Libraw buffer unpacker
 void
 Unpacker(int index, std::unique_ptr<ProcessingParams>& processing_entry, std::unique_ptr<std::vector<char>>& raw_buffer,
@@ -410,7 +622,7 @@ Unpacker(int index, std::unique_ptr<ProcessingParams>& processing_entry, std::un
     auto& processing = processing_entry;
     spdlog::info("Unpack: file {}", processing->srcFile);
 
-    processing->raw_data = std::make_unique<LibRaw>();
+    processing->raw_data = std::make_unique<FusedLibRaw>();
     LibRaw* raw          = processing->raw_data.get();
 
     raw->imgdata.params.use_camera_matrix = settings.rawParms.use_camera_matrix;
@@ -514,17 +726,208 @@ Dcraw(int index, std::unique_ptr<ProcessingParams>& processing_entry, std::atomi
     auto& raw_parms      = raw->imgdata.params;
     raw_parms.output_bps = 16;
 
-    processing->raw_image = raw->dcraw_make_mem_image();
+    if (useFusedConvert()) {
+        // LUT and unsharp keep working on 16bit input, otherwise convert straight to the output format
+        bool postProcess     = (settings.lutMode >= 0 && processing->lut_preset != "") || settings.sharp_mode != -1
+                           || !processing->variants.empty();
+        TypeDesc conv_format = postProcess ? TypeDesc::UINT16
+                                           : getTypeDesc(settings.bitDepth != -1 ? settings.bitDepth : settings.defBDepth);
 
-    if (!processing->raw_image) {
-        spdlog::error("Dcraw: Cannot process data from file: {}", processing->srcFile);
-        return;
+        auto conv_buf = std::make_unique<ImageBuf>();
+        if (!rawFusedConvert(static_cast<FusedLibRaw*>(raw.get()), conv_format, *conv_buf)) {
+            spdlog::error("Dcraw: Cannot convert data from file: {}", processing->srcFile);
+            return;
+        }
+        processing->image      = std::move(conv_buf);
+        processing->raw_image  = nullptr;
+        processing->rawCleared = true;
+    } else {
+        processing->raw_image = raw->dcraw_make_mem_image();
+
+        if (!processing->raw_image) {
+            spdlog::error("Dcraw: Cannot process data from file: {}", processing->srcFile);
+            return;
+        }
     }
 
     (*fileCntr)--;
     (*myPools)["processor"]->enqueue(Processor, index, std::ref(processing_entry), fileCntr, myPools);
 }
 
+// LUT file of a preset, or its per camera version when exif_lut is enabled and the camera has one
+static fs::path
+lutPath(const std::string& preset, std::unique_ptr<ProcessingParams>& processing)
+{
+    fs::path lutPreset = settings.lut_Preset.at(preset);
+
+    if (settings.perCamera
+        && procGlobals.lut_registry.cameraLut(preset, processing->m_exif.make, processing->m_exif.model)) {
+        std::string lut_ext  = lutPreset.extension().string();
+        std::string lut_file = lutPreset.stem().string();
+        fs::path lut_dir     = lutPreset.parent_path();
+
+        lutPreset = lut_dir / (lut_file + "_" + processing->m_exif.make + "_" + processing->m_exif.model + lut_ext);
+    }
+    return lutPreset;
+}
+
+// LUT registry name of a preset, per camera LUT files are registered under their own stem.
+// Cameras without a LUT file use the preset itself.
+static std::string
+lutName(const std::string& preset, std::unique_ptr<ProcessingParams>& processing)
+{
+    if (!settings.perCamera) {
+        return preset;
+    }
+    return procGlobals.lut_registry.cameraLut(preset, processing->m_exif.make, processing->m_exif.model)
+        .value_or(preset);
+}
+
+// Format of the LUT/unsharp working images, the output format unless WorkingPrecision is set
+static TypeDesc
+workFormat(TypeDesc out_format)
+{
+    switch (settings.workPrecision) {
+    case 0: return TypeDesc::HALF;
+    case 1: return TypeDesc::FLOAT;
+    case 2: return TypeDesc::UINT16;
+    }
+    return out_format;
+}
+
+// Wraps pooled storage for a full frame scratch image, falls back to ImageBuf's own allocation
+static void
+scratchImage(ImageBuf& buf, PooledBuffer& mem, const ImageSpec& spec)
+{
+    mem = procGlobals.buffer_pool.acquire(spec.image_bytes());
+    if (mem) {
+        buf.reset(spec, mem.data());
+    } else {
+        buf.reset(spec);
+    }
+}
+
+// Applies a LUT with the shared registry processor, unknown LUTs go through OIIO's file transform
+static bool
+applyLut(ImageBuf& dst, const ImageBuf& src, const std::string& preset, std::unique_ptr<ProcessingParams>& processing,
+         int nthreads = 0)
+{
+    std::string name = lutName(preset, processing);
+    if (auto lut3d = procGlobals.lut_registry.getNative(name)) {
+        return lut3d->apply(dst, src, nthreads);
+    }
+    if (auto processor = procGlobals.lut_registry.get(name)) {
+        return ImageBufAlgo::colorconvert(dst, src, processor.get(), false, {}, nthreads);
+    }
+    return ImageBufAlgo::ociofiletransform(dst, src, lutPath(preset, processing).string(), false, false,
+                                           procGlobals.ocio_conf_ptr.get(), {}, nthreads);
+}
+
+// Renders an output variant from the decoded image, src is left untouched for the main export
+static bool
+processVariant(const ImageBuf& src, const ImageSpec& src_spec, std::unique_ptr<ProcessingParams>& processing,
+               VariantOutput& variant)
+{
+    const OutputVariant& cfg = settings.variants[variant.variant];
+
+    int bitDepth        = cfg.bitDepth != -1 ? cfg.bitDepth : (settings.bitDepth != -1 ? settings.bitDepth : settings.defBDepth);
+    TypeDesc out_format = getTypeDesc(bitDepth);
+
+    ImageSpec work_spec = src_spec;
+    work_spec.set_format(workFormat(out_format));
+
+    ImageBuf lut_buf;
+    ImageBuf uns_buf;
+    const ImageBuf* cur_buf = &src;
+    ImageBuf* own_buf       = nullptr;
+
+    if (settings.lutMode >= 0 && variant.lut_preset != "") {
+        lut_buf.reset(work_spec);
+        if (applyLut(lut_buf, *cur_buf, variant.lut_preset, processing)) {
+            cur_buf = own_buf = &lut_buf;
+        } else {
+            spdlog::error("Variant: LUT not applied: {}", lut_buf.geterror());
+        }
+    }
+
+    if (settings.sharp_mode != -1) {
+        uns_buf.reset(work_spec);
+        if (unsharpMask(uns_buf, *cur_buf, settings.sharp_kerns[settings.sharp_kernel], settings.sharp_width,
+                        settings.sharp_contrast, settings.sharp_tresh)) {
+            cur_buf = own_buf = &uns_buf;
+            lut_buf.reset();
+        } else {
+            spdlog::error("Variant: Unsharp mask not applied: {}", uns_buf.geterror());
+        }
+    }
+
+    auto& crops   = processing->m_crops;
+    variant.crops = { crops.left, crops.top, crops.width, crops.height };
+
+    RangeMap range = rangeMap(settings.rangeMode);
+    auto out_buf   = std::make_unique<ImageBuf>();
+    if (cfg.scale < 1.0f) {
+        // crop first, so the scaled image is written as is
+        ROI crop_roi = settings.crop_mode != -1 ? ROI(crops.left, crops.left + crops.width, crops.top,
+                                                      crops.top + crops.height, 0, 1, 0, cur_buf->nchannels())
+                                                : cur_buf->roi();
+        ImageBuf cut_buf;
+        if (!ImageBufAlgo::cut(cut_buf, *cur_buf, crop_roi)) {
+            spdlog::error("Variant: Cannot crop image: {}", cut_buf.geterror());
+            return false;
+        }
+
+        int width  = std::max(1, int(crop_roi.width() * cfg.scale + 0.5f));
+        int height = std::max(1, int(crop_roi.height() * cfg.scale + 0.5f));
+        // with a range mapping resize in float, an integer out_format would clamp signed values first
+        TypeDesc resize_format = range.active() ? TypeDesc::FLOAT : out_format;
+        ImageBuf resized(ImageSpec(width, height, cut_buf.nchannels(), resize_format));
+        if (!ImageBufAlgo::resize(resized, cut_buf, "lanczos3")) {
+            spdlog::error("Variant: Cannot resize image: {}", resized.geterror());
+            return false;
+        }
+        variant.crops = { 0, 0, width, height };
+        if (!range.active()) {
+            out_buf->swap(resized);
+        } else if (!convertRange(*out_buf, resized, out_format, range)) {
+            spdlog::error("Variant: Cannot convert range: {}", out_buf->geterror());
+            return false;
+        }
+    } else if (own_buf == nullptr || own_buf->spec().format != out_format || range.active()) {
+        if (!convertRange(*out_buf, *cur_buf, out_format, range)) {
+            spdlog::error("Variant: Cannot copy image buffer: {}", out_buf->geterror());
+            return false;
+        }
+    } else {
+        out_buf->swap(*own_buf);
+    }
+
+    variant.outSpec                = std::make_unique<ImageSpec>(out_buf->spec());
+    variant.outSpec->extra_attribs = src_spec.extra_attribs;
+    variant.image                  = std::move(out_buf);
+    return true;
+}
+
+// Enqueues the main export and its extra formats. Extra formats share the processed image with the main export,
+// the last finished write releases it. They are enqueued before Writer so their spec copies are taken before
+// Writer sets its own attributes.
+static void
+enqueueWriters(int index, std::unique_ptr<ProcessingParams>& processing_entry, std::atomic_size_t* fileCntr,
+               std::map<std::string, std::unique_ptr<ThreadPool>>* myPools)
+{
+    auto& processing = processing_entry;
+    if (!processing->extraFormats.empty()) {
+        processing->pendingWrites += static_cast<int>(processing->extraFormats.size())
+                                     + (processing->variants.empty() ? 1 : 0);
+        for (int format : processing->extraFormats) {
+            (*myPools)["writer"]->enqueue(FormatWriter, index, std::ref(processing_entry), format,
+                                          *processing->outSpec, fileCntr, myPools);
+        }
+    }
+
+    (*myPools)["writer"]->enqueue(Writer, index, std::ref(processing_entry), fileCntr, myPools);
+}
+
 void
 Processor(int index, std::unique_ptr<ProcessingParams>& processing_entry, std::atomic_size_t* fileCntr,
           std::map<std::string, std::unique_ptr<ThreadPool>>* myPools)
@@ -536,23 +939,104 @@ Processor(int index, std::unique_ptr<ProcessingParams>& processing_entry, std::a
 
     libraw_processed_image_t* image = processing->raw_image;
 
-    spdlog::trace("Processor: RAW Image buffer: {}", reinterpret_cast<uintptr_t>(&image->data));
+    OIIO::ImageSpec image_spec;
+    OIIO::ImageBuf image_buf;
+    if (image) {
+        spdlog::trace("Processor: RAW Image buffer: {}", reinterpret_cast<uintptr_t>(&image->data));
 
-    OIIO::ImageSpec image_spec(image->width, image->height, image->colors, OIIO::TypeDesc::UINT16);
-    OIIO::ImageBuf image_buf(image_spec, image->data);
+        image_spec = OIIO::ImageSpec(image->width, image->height, image->colors, OIIO::TypeDesc::UINT16);
+        image_buf.reset(image_spec, image->data);
+    } else {
+        // fused Dcraw output, already converted
+        image_buf.swap(*processing->image);
+        processing->image.reset();
+        image_spec = image_buf.spec();
+    }
 
     EXIF::get_exif(processing->raw_data, image_spec);
+    if (processing->orientation != 1) {
+        image_spec.attribute("Orientation", processing->orientation);
+    }
 
     TypeDesc out_format = getTypeDesc(settings.bitDepth != -1 ? settings.bitDepth : settings.defBDepth);
 
     spdlog::debug("Processor: Output format: {}", formatText(out_format));
 
+    // Fan out variants from the decoded image before the main export consumes it
+    if (!processing->variants.empty()) {
+        processing->pendingWrites = static_cast<int>(processing->variants.size()) + 1;
+        for (size_t v = 0; v < processing->variants.size(); v++) {
+            if (processVariant(image_buf, image_spec, processing, processing->variants[v])) {
+                (*myPools)["writer"]->enqueue(VariantWriter, index, std::ref(processing_entry), v, fileCntr, myPools);
+            } else {
+                spdlog::error("Processor: Variant {} failed for file: {}", processing->variants[v].outFile,
+                              processing->srcFile);
+                processing->pendingWrites--;
+            }
+        }
+    }
+
     ImageSpec processing_spec = image_spec;
 
     processing_spec.set_format(out_format);
 
-    ImageBuf lut_buf(processing_spec);
-    ImageBuf uns_buf(processing_spec);
+    bool doLut   = settings.lutMode >= 0 && processing->lut_preset != "";
+    bool doSharp = settings.sharp_mode != -1;
+    if (settings.tiledProcess && (doLut || doSharp)) {
+        TileOps ops;
+        if (doLut) {
+            ops.lut = [&processing](ImageBuf& dst, const ImageBuf& src, int nthreads) {
+                return applyLut(dst, src, processing->lut_preset, processing, nthreads);
+            };
+        }
+        ops.sharpen   = doSharp;
+        ops.kernel    = settings.sharp_kerns[settings.sharp_kernel];
+        ops.width     = settings.sharp_width;
+        ops.contrast  = settings.sharp_contrast;
+        ops.threshold = settings.sharp_tresh;
+        ops.range     = rangeMap(settings.rangeMode);
+
+        auto out_buf = std::make_unique<ImageBuf>();
+        PooledBuffer out_mem;
+        scratchImage(*out_buf, out_mem, processing_spec);
+        if (tiledProcess(image_buf, *out_buf, out_format, ops)) {
+            spdlog::debug("Processor: Tiled pass done, LUT: {} unsharp: {}", doLut, doSharp);
+            if (doLut) {
+                spdlog::info("LUT preset {} <{}> applied", processing->lut_preset,
+                             lutName(processing->lut_preset, processing));
+                processing_entry->setStatus(ProcessingStatus::Graded);
+            }
+            if (doSharp) {
+                processing_entry->setStatus(ProcessingStatus::Unsharped);
+            }
+            image_buf.reset();
+            if (!processing_entry->rawCleared) {
+                processing_entry->raw_data->dcraw_clear_mem(image);
+                processing_entry->rawCleared = true;
+            }
+
+            processing->scratch = std::move(out_mem);
+            processing->image   = std::move(out_buf);
+            processing->outSpec = std::make_unique<OIIO::ImageSpec>(processing_spec);
+            processing->setStatus(ProcessingStatus::Processed);
+
+            (*fileCntr) -= 2;
+            enqueueWriters(index, processing_entry, fileCntr, myPools);
+            return;
+        }
+        spdlog::warn("Processor: Tiled pass failed, falling back to full frame processing");
+    }
+
+    // LUT and unsharp run at the working precision, the result is converted to out_format once
+    ImageSpec work_spec = image_spec;
+    work_spec.set_format(workFormat(out_format));
+    spdlog::debug("Processor: Working format: {}", formatText(work_spec.format));
+
+    // scratch images get pooled storage only when their step runs
+    ImageBuf lut_buf;
+    ImageBuf uns_buf;
+    PooledBuffer lut_mem;
+    PooledBuffer uns_mem;
     ImageBuf* lut_buf_ptr = &lut_buf;
     ImageBuf* uns_buf_ptr = &uns_buf;
     // LUT Transform
@@ -566,21 +1050,10 @@ Processor(int index, std::unique_ptr<ProcessingParams>& processing_entry, std::a
     spdlog::trace("LUT: Input Image buffer: {}", reinterpret_cast<uintptr_t>(image_buf.localpixels()));
 
     if (settings.lutMode >= 0 && lutValid) {
-        fs::path lutPreset = settings.lut_Preset.at(processing->lut_preset);
-
-        if (settings.perCamera) {
-            std::string lut_ext  = lutPreset.extension().string();
-            std::string lut_file = lutPreset.stem().string();
-            fs::path lut_dir     = lutPreset.parent_path();
-
-            fs::path new_lut = lut_dir
-                               / (lut_file + "_" + processing->m_exif.make + "_" + processing->m_exif.model + lut_ext);
-            lutPreset = new_lut;
-        }
-
-        if (ImageBufAlgo::ociofiletransform(*lut_buf_ptr, image_buf, lutPreset.string(), false, false,
-                                            procGlobals.ocio_conf_ptr.get())) {
-            spdlog::info("LUT preset {} <{}> applied", processing->lut_preset, lutPreset.string());
+        scratchImage(lut_buf, lut_mem, work_spec);
+        if (applyLut(*lut_buf_ptr, image_buf, processing->lut_preset, processing)) {
+            spdlog::info("LUT preset {} <{}> applied", processing->lut_preset,
+                         lutName(processing->lut_preset, processing));
             processing_entry->setStatus(ProcessingStatus::Graded);
             image_buf.reset();
             if (!processing_entry->rawCleared) {
@@ -601,17 +1074,19 @@ Processor(int index, std::unique_ptr<ProcessingParams>& processing_entry, std::a
     // Apply unsharp mask
 
     if (settings.sharp_mode != -1) {
-        string_view kernel = settings.sharp_kerns[settings.sharp_kernel];
-        float width        = settings.sharp_width;
-        float contrast     = settings.sharp_contrast;
-        float threshold    = settings.sharp_tresh;
-        if (ImageBufAlgo::unsharp_mask(*uns_buf_ptr, *lut_buf_ptr, kernel, width, contrast, threshold)) {
+        const std::string& kernel = settings.sharp_kerns[settings.sharp_kernel];
+        float width               = settings.sharp_width;
+        float contrast            = settings.sharp_contrast;
+        float threshold           = settings.sharp_tresh;
+        scratchImage(uns_buf, uns_mem, work_spec);
+        if (unsharpMask(*uns_buf_ptr, *lut_buf_ptr, kernel, width, contrast, threshold)) {
             spdlog::debug("Unsharp mask applied: <{}>", kernel.c_str());
             spdlog::trace("Unsharp: Out Image buffer: {}", reinterpret_cast<uintptr_t>(uns_buf_ptr->localpixels()));
             spdlog::debug("Unsharp: kernel: {} width: {} contrast: {} threshold: {}", kernel.data(), width, contrast,
                           threshold);
             processing_entry->setStatus(ProcessingStatus::Unsharped);
             lut_buf_ptr->reset();
+            lut_mem.release();
             if (!processing_entry->rawCleared) {
                 processing_entry->raw_data->dcraw_clear_mem(image);
                 processing_entry->rawCleared = true;
@@ -625,15 +1100,26 @@ Processor(int index, std::unique_ptr<ProcessingParams>& processing_entry, std::a
         uns_buf_ptr = lut_buf_ptr;
     }
 
-    // copy for saving
+    // copy for saving, working precision images are converted to the output format and RangeMode
+    // is applied here in the same pass
     ImageBuf* out_buf_ptr = uns_buf_ptr;
-    if (settings.lutMode == -1 && settings.sharp_mode == -1 && image_buf.spec().format != out_format) {
-        spdlog::debug("Processor: Copying image buffer as format: {}", out_format.basetype);
-        if (!ImageBufAlgo::copy(*out_buf_ptr, image_buf, out_format)) {
+    ImageBuf conv_buf;
+    PooledBuffer conv_mem;
+    RangeMap range = rangeMap(settings.rangeMode);
+    bool convert   = out_buf_ptr != &image_buf || (settings.lutMode == -1 && settings.sharp_mode == -1);
+    if ((convert && out_buf_ptr->spec().format != out_format) || range.active()) {
+        spdlog::debug("Processor: Copying image buffer as format: {}", formatText(out_format));
+        scratchImage(conv_buf, conv_mem, processing_spec);
+        if (!convertRange(conv_buf, *out_buf_ptr, out_format, range)) {
             spdlog::error("Processor: Cannot copy image buffer");
-            spdlog::error("Processor: Cannot copy image buffer: {}", out_buf_ptr->geterror());
+            spdlog::error("Processor: Cannot copy image buffer: {}", conv_buf.geterror());
             return;
         }
+        lut_buf.reset();
+        uns_buf.reset();
+        lut_mem.release();
+        uns_mem.release();
+        out_buf_ptr = &conv_buf;
     }
 
     spdlog::trace("Unsharp: Unsh Image buffer: {}", reinterpret_cast<uintptr_t>(uns_buf_ptr->localpixels()));
@@ -641,14 +1127,88 @@ Processor(int index, std::unique_ptr<ProcessingParams>& processing_entry, std::a
 
     spdlog::trace("Processor: Result output image format: {}", out_buf_ptr->spec().format.c_str());
 
-    processing->image   = std::make_unique<ImageBuf>(*out_buf_ptr);
-    processing->outSpec = std::make_unique<OIIO::ImageSpec>(out_buf_ptr->spec());
+    if (out_buf_ptr == &lut_buf) {
+        processing->scratch = std::move(lut_mem);
+    } else if (out_buf_ptr == &uns_buf) {
+        processing->scratch = std::move(uns_mem);
+    } else if (out_buf_ptr == &conv_buf) {
+        processing->scratch = std::move(conv_mem);
+    }
+    processing->image   = std::make_unique<ImageBuf>(std::move(*out_buf_ptr));
+    processing->outSpec = std::make_unique<OIIO::ImageSpec>(processing->image->spec());
+    if (processing->orientation != 1) {
+        processing->outSpec->attribute("Orientation", processing->orientation);
+    }
 
     processing->setStatus(ProcessingStatus::Processed);
 
     (*fileCntr)--;
 
-    (*myPools)["writer"]->enqueue(Writer, index, std::ref(processing_entry), fileCntr, myPools);
+    enqueueWriters(index, processing_entry, fileCntr, myPools);
+}
+
+// img_write, adding the written file to the batch manifest when checksums are on
+static bool
+writeOutput(const ProcessingParams& processing, std::unique_ptr<ImageBuf>& buf, std::unique_ptr<ImageSpec>& spec,
+            const std::string& fileName, std::array<int, 4> crops, int fileFormat,
+            const std::vector<std::unique_ptr<ImageBuf>>* subimages = nullptr)
+{
+    if (!settings.checksums) {
+        return img_write(buf, spec, fileName, crops, fileFormat, subimages);
+    }
+    OutputDigest digest;
+    if (!img_write(buf, spec, fileName, crops, fileFormat, subimages, &digest)) {
+        return false;
+    }
+    if (digest.valid) {
+        manifestAdd(processing.srcFile, fileName, digest);
+    }
+    return true;
+}
+
+// Adds a file written outside img_write to the batch manifest, hashed by reading it back
+static void
+manifestFile(const ProcessingParams& processing, const std::string& fileName, double seconds)
+{
+    OutputDigest digest;
+    if (digestFile(fileName, digest)) {
+        digest.seconds = seconds;
+        manifestAdd(processing.srcFile, fileName, digest);
+    }
+}
+
+// Frees the processed image and the LibRaw image memory it may wrap without a copy
+static void
+releaseImage(ProcessingParams& processing)
+{
+    if (processing.image) {
+        processing.image->reset();
+        processing.image.reset();
+    }
+    if (!processing.rawCleared && processing.raw_data && processing.raw_image) {
+        processing.raw_data->dcraw_clear_mem(processing.raw_image);
+        processing.rawCleared = true;
+    }
+}
+
+// Releases the file once its last output (main export, variant or extra format) is written or has failed
+static void
+finishWrite(int index, std::unique_ptr<ProcessingParams>& processing_entry, std::atomic_size_t* fileCntr)
+{
+    auto& processing = processing_entry;
+    if (processing->pendingWrites.fetch_sub(1) > 1) {
+        return;
+    }
+
+    processing->setStatus(ProcessingStatus::Written);
+
+    releaseImage(*processing);
+
+    processing->raw_data.reset();
+    processing->raw_image = nullptr;
+    processing.reset();
+
+    (*fileCntr) = 0;
 }
 
 void
@@ -677,16 +1237,19 @@ Writer(int index, std::unique_ptr<ProcessingParams>& processing_entry, std::atom
 
     if (!makePath(outDir)) {
         spdlog::error("Writer: Cannot create output directory: {}", outFilePath);
+        finishWrite(index, processing_entry, fileCntr);
         return;
     };
 
     spdlog::info("Writer: Writing data to file: {}", outFilePath);
-    if (settings.dDemosaic == -2) {
+    mTimer timer;
+    if (settings.dDemosaic == -2 && !settings.proxyMode) {
         // Write raw data to a file
         outFilePath = outDir + "/" + processing->outFile + ".ppm";
         std::ofstream output(outFilePath, std::ios::binary);
         if (!output) {
             spdlog::error("Writer: Cannot open output file: {}", outFilePath);
+            finishWrite(index, processing_entry, fileCntr);
             return;
         }
 
@@ -706,7 +1269,10 @@ Writer(int index, std::unique_ptr<ProcessingParams>& processing_entry, std::atom
         }
 
         output.close();
-    } else if (settings.dDemosaic == -1)  // writing color ppm/tiff using dcraw_ppm_tiff_writer
+        if (settings.checksums) {
+            manifestFile(*processing, outFilePath, timer.now<double>());
+        }
+    } else if (settings.dDemosaic == -1 && !settings.proxyMode)  // writing color ppm/tiff using dcraw_ppm_tiff_writer
     {
         if (settings.fileFormat == -1) {
             if (settings.defFormat == 0) {
@@ -723,29 +1289,56 @@ Writer(int index, std::unique_ptr<ProcessingParams>& processing_entry, std::atom
         if (ret != LIBRAW_SUCCESS) {
             spdlog::error("Writer: Cannot write image to file: {}", outFilePath);
             processing->raw_data.reset();
+            finishWrite(index, processing_entry, fileCntr);
             return;
         }
+        if (settings.checksums) {
+            manifestFile(*processing, outFilePath, timer.now<double>());
+        }
     } else {  // Write processed image using oiio
         spdlog::trace("Writer: Inp Image buffer: {}", reinterpret_cast<uintptr_t>(processing->image->localpixels()));
-        bool write_ok = img_write(processing->image, processing->outSpec, outFilePath, crops);
+        std::vector<std::unique_ptr<ImageBuf>> pyramid;
+        bool multiImage = false;
+        if (settings.pyramidLevels > 0) {
+            ROI roi = settings.crop_mode != -1 ? ROI(crops[0], crops[0] + crops[2], crops[1], crops[1] + crops[3], 0,
+                                                     1, 0, processing->image->nchannels())
+                                               : processing->image->roi();
+            pyramid = buildPyramid(*processing->image, roi, settings.pyramidLevels);
+            std::string ext = processing->outExt;
+            std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+            multiImage = settings.pyramidMode == 1 && (ext == ".tif" || ext == ".tiff" || ext == ".exr");
+        }
+
+        bool write_ok = writeOutput(*processing, processing->image, processing->outSpec, outFilePath, crops,
+                                    settings.fileFormat, multiImage ? &pyramid : nullptr);
         if (!write_ok) {
             spdlog::error("Writer: Error writing: {}", outFilePath);
+            finishWrite(index, processing_entry, fileCntr);
             return;
         }
 
-        if (!processing->rawCleared) {
-            processing->raw_data->dcraw_clear_mem(processing->raw_image);
-            processing->rawCleared = true;
+        // Pyramid levels as separate files, named with the resolution divisor
+        for (size_t i = 0; i < pyramid.size() && !multiImage; i++) {
+            std::string levelPath = outDir + "/" + processing->outFile + "_" + std::to_string(2 << i)
+                                    + processing->outExt;
+            auto levelSpec = std::make_unique<ImageSpec>(pyramidSpec(*processing->outSpec, *pyramid[i]));
+            std::array<int, 4> levelCrops = { 0, 0, levelSpec->width, levelSpec->height };
+            spdlog::info("Writer: Writing pyramid level {} to file: {}", i + 1, levelPath);
+            if (!writeOutput(*processing, pyramid[i], levelSpec, levelPath, levelCrops, settings.fileFormat)) {
+                spdlog::error("Writer: Error writing: {}", levelPath);
+            }
         }
+        pyramid.clear();
 
-        processing->image->reset();
-        processing->image.reset();
+        // extra formats may still be reading the image (and the LibRaw memory under it), finishWrite releases it
+        if (processing->extraFormats.empty()) {
+            releaseImage(*processing);
+        }
 
         processing->outSpec.reset();
         processing->srcSpec.reset();
     }
 
-    processing->setStatus(ProcessingStatus::Written);
     spdlog::debug("Writer: Finished writing data to file: {}", outFilePath);
 
     const auto preview_enqueue = procGlobals.previewSink.enqueue.load(std::memory_order_acquire);
@@ -759,11 +1352,58 @@ Writer(int index, std::unique_ptr<ProcessingParams>& processing_entry, std::atom
         preview_enqueue(preview_user, outFilePath.c_str(), index + 1, total_files);
     }
 
-    processing->raw_data.reset();
-    processing->raw_image = nullptr;
-    processing.reset();
+    finishWrite(index, processing_entry, fileCntr);
+}
 
-    (*fileCntr) = 0;
+void
+VariantWriter(int index, std::unique_ptr<ProcessingParams>& processing_entry, size_t variant_idx,
+              std::atomic_size_t* fileCntr, std::map<std::string, std::unique_ptr<ThreadPool>>* myPools)
+{
+    auto& processing = processing_entry;
+    auto& variant    = processing->variants[variant_idx];
+
+    std::string outDir      = outpaths.get_path(processing->outPathIdx);
+    std::string outFilePath = outDir + "/" + variant.outFile + variant.outExt;
+
+    if (!makePath(outDir)) {
+        spdlog::error("Writer: Cannot create output directory: {}", outFilePath);
+    } else {
+        spdlog::info("Writer: Writing variant to file: {}", outFilePath);
+        if (!writeOutput(*processing, variant.image, variant.outSpec, outFilePath, variant.crops,
+                         variant.fileFormat)) {
+            spdlog::error("Writer: Error writing: {}", outFilePath);
+        }
+    }
+
+    variant.image.reset();
+    variant.outSpec.reset();
+
+    finishWrite(index, processing_entry, fileCntr);
+}
+
+void
+FormatWriter(int index, std::unique_ptr<ProcessingParams>& processing_entry, int fileFormat, OIIO::ImageSpec spec,
+             std::atomic_size_t* fileCntr, std::map<std::string, std::unique_ptr<ThreadPool>>* myPools)
+{
+    auto& processing         = processing_entry;
+    std::array<int, 4> crops = { processing->m_crops.left, processing->m_crops.top, processing->m_crops.width,
+                                 processing->m_crops.height };
+
+    std::string outDir      = outpaths.get_path(processing->outPathIdx);
+    std::string outFilePath = outDir + "/" + processing->outFile + getFormatExt(fileFormat, &settings);
+
+    if (!makePath(outDir)) {
+        spdlog::error("Writer: Cannot create output directory: {}", outFilePath);
+    } else {
+        // own spec, img_write sets per format attributes on it; the image is only read
+        auto outSpec = std::make_unique<ImageSpec>(std::move(spec));
+        spdlog::info("Writer: Writing extra format to file: {}", outFilePath);
+        if (!writeOutput(*processing, processing->image, outSpec, outFilePath, crops, fileFormat)) {
+            spdlog::error("Writer: Error writing: {}", outFilePath);
+        }
+    }
+
+    finishWrite(index, processing_entry, fileCntr);
 }
 
 void
@@ -59,6 +59,10 @@ void
 LUnpacker(int index, std::unique_ptr<ProcessingParams>& processing_entry, std::atomic_size_t* fileCntr,
           std::map<std::string, std::unique_ptr<ThreadPool>>* myPools);
 
+void
+Proxy(int index, std::unique_ptr<ProcessingParams>& processing_entry, std::atomic_size_t* fileCntr,
+      std::map<std::string, std::unique_ptr<ThreadPool>>* myPools);
+
 void
 Unpacker(int index, std::unique_ptr<ProcessingParams>& processing_entry,
          std::unique_ptr<std::vector<char>>& raw_buffer_ptr, std::atomic_size_t* fileCntr,
@@ -83,6 +87,14 @@ void
 Writer(int index, std::unique_ptr<ProcessingParams>& processing_entry, std::atomic_size_t* fileCntr,
        std::map<std::string, std::unique_ptr<ThreadPool>>* myPools);
 
+void
+VariantWriter(int index, std::unique_ptr<ProcessingParams>& processing_entry, size_t variant_idx,
+              std::atomic_size_t* fileCntr, std::map<std::string, std::unique_ptr<ThreadPool>>* myPools);
+
+void
+FormatWriter(int index, std::unique_ptr<ProcessingParams>& processing_entry, int fileFormat, OIIO::ImageSpec spec,
+             std::atomic_size_t* fileCntr, std::map<std::string, std::unique_ptr<ThreadPool>>* myPools);
+
 void
 Dummy(int index, std::unique_ptr<ProcessingParams>& processing_entry, std::atomic_size_t* fileCntr,
       std::map<std::string, std::unique_ptr<ThreadPool>>* myPools);
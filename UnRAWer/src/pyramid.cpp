@@ -0,0 +1,138 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "pch.h"
+
+#include "pyramid.h"
+#include "Timer.h"
+
+#include <OpenImageIO/parallel.h>
+
+using namespace OIIO;
+
+// Halves one row pair: vertical sum of the two rows, then the horizontal pair sum.
+// Plain loops over contiguous floats, both passes vectorize.
+static void
+halveRows(const float* top, const float* bottom, float* sum, float* out, int width, int outWidth, int nch)
+{
+    const size_t n = size_t(width) * nch;
+    for (size_t i = 0; i < n; i++) {
+        sum[i] = top[i] + bottom[i];
+    }
+    const int pairs = width / 2;
+    for (int x = 0; x < pairs; x++) {
+        const float* a = sum + size_t(2 * x) * nch;
+        const float* b = a + nch;
+        float* o       = out + size_t(x) * nch;
+        for (int c = 0; c < nch; c++) {
+            o[c] = (a[c] + b[c]) * 0.25f;
+        }
+    }
+    if (outWidth > pairs) {
+        const float* a = sum + size_t(width - 1) * nch;
+        float* o       = out + size_t(pairs) * nch;
+        for (int c = 0; c < nch; c++) {
+            o[c] = a[c] * 0.5f;
+        }
+    }
+}
+
+static std::unique_ptr<ImageBuf>
+halve(const ImageBuf& src, ROI roi)
+{
+    const int width     = roi.width();
+    const int height    = roi.height();
+    const int nch       = src.nchannels();
+    const int outWidth  = (width + 1) / 2;
+    const int outHeight = (height + 1) / 2;
+
+    ImageSpec spec(outWidth, outHeight, nch, src.spec().format);
+    spec.channelnames  = src.spec().channelnames;
+    spec.alpha_channel = src.spec().alpha_channel;
+    auto dst           = std::make_unique<ImageBuf>(spec, InitializePixels::No);
+
+    std::atomic<bool> ok { true };
+    parallel_for(int64_t(0), int64_t(outHeight), [&](int64_t y) {
+        thread_local std::vector<float> rows;
+        const size_t n = size_t(width) * nch;
+        rows.resize(n * 3 + size_t(outWidth) * nch);
+        float* top    = rows.data();
+        float* bottom = top + n;
+        float* sum    = bottom + n;
+        float* out    = sum + n;
+
+        const int y0 = roi.ybegin + int(y) * 2;
+        const int y1 = std::min(y0 + 1, roi.yend - 1);
+        ROI line0(roi.xbegin, roi.xend, y0, y0 + 1, roi.zbegin, roi.zbegin + 1, 0, nch);
+        ROI line1(roi.xbegin, roi.xend, y1, y1 + 1, roi.zbegin, roi.zbegin + 1, 0, nch);
+        if (!src.get_pixels(line0, TypeDesc::FLOAT, top) || !src.get_pixels(line1, TypeDesc::FLOAT, bottom)) {
+            ok = false;
+            return;
+        }
+        halveRows(top, bottom, sum, out, width, outWidth, nch);
+        ROI outLine(0, outWidth, int(y), int(y) + 1, 0, 1, 0, nch);
+        if (!dst->set_pixels(outLine, TypeDesc::FLOAT, out)) {
+            ok = false;
+        }
+    });
+    if (!ok) {
+        return nullptr;
+    }
+    return dst;
+}
+
+std::vector<std::unique_ptr<ImageBuf>>
+buildPyramid(const ImageBuf& buf, ROI roi, int levels)
+{
+    std::vector<std::unique_ptr<ImageBuf>> pyramid;
+    mTimer timer;
+    const ImageBuf* src = &buf;
+    for (int level = 1; level <= levels; level++) {
+        if (roi.width() < 2 || roi.height() < 2) {
+            spdlog::warn("Pyramid: {}x{} is too small to halve, {} of {} levels built", roi.width(), roi.height(),
+                         level - 1, levels);
+            break;
+        }
+        auto half = halve(*src, roi);
+        if (!half) {
+            spdlog::error("Pyramid: Cannot build level {}", level);
+            break;
+        }
+        roi = half->roi();
+        src = half.get();
+        pyramid.push_back(std::move(half));
+    }
+    spdlog::debug("Pyramid: {} levels in {}", pyramid.size(), timer.nowText());
+    return pyramid;
+}
+
+ImageSpec
+pyramidSpec(const ImageSpec& spec, const ImageBuf& level)
+{
+    ImageSpec out   = spec;
+    out.x           = 0;
+    out.y           = 0;
+    out.full_x      = 0;
+    out.full_y      = 0;
+    out.width       = level.spec().width;
+    out.height      = level.spec().height;
+    out.full_width  = out.width;
+    out.full_height = out.height;
+    out.tile_width  = 0;
+    out.tile_height = 0;
+    return out;
+}
@@ -0,0 +1,37 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#ifndef PYRAMID_H
+#    define PYRAMID_H
+
+#    include <OpenImageIO/imagebuf.h>
+
+#    include <memory>
+#    include <vector>
+
+// Builds resolution levels 1/2, 1/4, ... of the roi of buf by successive 2x2 box averaging.
+// Odd edges repeat the last row/column. Levels keep the pixel format of buf and start at (0, 0).
+std::vector<std::unique_ptr<OIIO::ImageBuf>>
+buildPyramid(const OIIO::ImageBuf& buf, OIIO::ROI roi, int levels);
+
+// Output spec of a pyramid level: the metadata of spec with the size of level
+OIIO::ImageSpec
+pyramidSpec(const OIIO::ImageSpec& spec, const OIIO::ImageBuf& level);
+
+#endif  // !PYRAMID_H
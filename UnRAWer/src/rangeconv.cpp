@@ -0,0 +1,106 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "pch.h"
+
+#include "rangeconv.h"
+#include "Timer.h"
+
+#include <OpenImageIO/imagebufalgo.h>
+
+using namespace OIIO;
+
+RangeMap
+rangeMap(unsigned mode)
+{
+    RangeMap map;
+    switch (mode) {
+    case 2:  // [-1, 1] -> [0, 1]
+        map.scale  = 0.5f;
+        map.offset = 0.5f;
+        break;
+    case 3:  // [0, 1] -> [-1, 1]
+        map.scale  = 2.0f;
+        map.offset = -1.0f;
+        break;
+    }
+    return map;
+}
+
+void
+applyRange(float* pixels, size_t npixels, int nchannels, int alpha, const RangeMap& map)
+{
+    const float scale  = map.scale;
+    const float offset = map.offset;
+    if (alpha < 0 || alpha >= nchannels) {
+        const size_t n = npixels * nchannels;
+        for (size_t i = 0; i < n; i++) {
+            pixels[i] = pixels[i] * scale + offset;
+        }
+        return;
+    }
+    for (size_t p = 0; p < npixels; p++) {
+        float* px = pixels + p * nchannels;
+        for (int c = 0; c < nchannels; c++) {
+            px[c] = c == alpha ? px[c] : px[c] * scale + offset;
+        }
+    }
+}
+
+bool
+convertRange(ImageBuf& dst, const ImageBuf& src, TypeDesc format, const RangeMap& map, int nthreads)
+{
+    if (!map.active()) {
+        return ImageBufAlgo::copy(dst, src, format, {}, nthreads);
+    }
+
+    mTimer timer;
+    if (!dst.initialized()) {
+        ImageSpec spec = src.spec();
+        spec.set_format(format);
+        dst.reset(spec, InitializePixels::No);
+    }
+    if (format.basetype == TypeDesc::UINT8 || format.basetype == TypeDesc::UINT16
+        || format.basetype == TypeDesc::UINT32) {
+        if (map.offset < 0.0f) {
+            spdlog::warn("Range: signed values are clipped by the unsigned output format {}", format.c_str());
+        }
+    }
+
+    const int nch   = src.nchannels();
+    const int alpha = src.spec().alpha_channel;
+    std::atomic<bool> ok { true };
+    ImageBufAlgo::parallel_image(src.roi(), paropt(nthreads), [&](ROI roi) {
+        thread_local std::vector<float> row;
+        row.resize(size_t(roi.width()) * nch);
+        for (int y = roi.ybegin; y < roi.yend && ok; y++) {
+            ROI line(roi.xbegin, roi.xend, y, y + 1, roi.zbegin, roi.zbegin + 1, 0, nch);
+            if (!src.get_pixels(line, TypeDesc::FLOAT, row.data())) {
+                ok = false;
+                break;
+            }
+            applyRange(row.data(), roi.width(), nch, alpha, map);
+            if (!dst.set_pixels(line, TypeDesc::FLOAT, row.data())) {
+                ok = false;
+            }
+        }
+    });
+
+    spdlog::debug("Range: {}x{}x{} {} -> {} (x{} {:+}) in {}", src.spec().width, src.spec().height, nch,
+                  src.spec().format.c_str(), format.c_str(), map.scale, map.offset, timer.nowText());
+    return ok;
+}
@@ -0,0 +1,47 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#ifndef RANGECONV_H
+#    define RANGECONV_H
+
+#    include <OpenImageIO/imagebuf.h>
+
+// Linear value mapping of a RangeMode, v * scale + offset
+struct RangeMap {
+    float scale  = 1.0f;
+    float offset = 0.0f;
+
+    bool active() const { return scale != 1.0f || offset != 0.0f; }
+};
+
+// 0 - unsigned, 1 - signed: values are kept; 2 - signed -> unsigned, 3 - unsigned -> signed
+RangeMap
+rangeMap(unsigned mode);
+
+// Maps float pixels in place, the alpha channel (-1 for none) is left as is
+void
+applyRange(float* pixels, size_t npixels, int nchannels, int alpha, const RangeMap& map);
+
+// Converts src to format with the range mapping applied on the way, row by row in one pass.
+// dst is allocated if it is not initialized, dst may be src.
+bool
+convertRange(OIIO::ImageBuf& dst, const OIIO::ImageBuf& src, OIIO::TypeDesc format, const RangeMap& map,
+             int nthreads = 0);
+
+#endif  // !RANGECONV_H
@@ -0,0 +1,358 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "pch.h"
+
+#include "rawcache.h"
+#include "settings.h"
+
+#include <libraw/libraw.h>
+
+#include <cstring>
+
+namespace fs = std::filesystem;
+
+static constexpr char kMagic[4]         = { 'U', 'R', 'C', '1' };
+static constexpr uint32_t kCacheVersion = 1;
+static constexpr uint64_t kDataAlign    = 4096;  // pixel data starts on a page boundary
+static constexpr uint64_t kMaxKeySize   = 65536;
+static constexpr const char* kCacheExt  = ".urc";
+static constexpr const char* kCacheDir  = "unrawer_cache";
+
+// Which of the LibRaw raw buffers holds the data
+enum RawLayout : uint32_t {
+    Bayer  = 0,
+    Color4 = 1,
+    Color3 = 2,
+    Float1 = 3,
+    Float3 = 4,
+    Float4 = 5,
+};
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t librawVersion;
+    uint32_t layout;
+    // LibRaw structures are stored as is, their sizes guard against a different build
+    uint32_t sizesSize;
+    uint32_t iparamsSize;
+    uint32_t ioparamsSize;
+    uint32_t colorSize;
+    uint64_t keySize;  // source key, checked against file name hash collisions
+    uint64_t dataOffset;
+    uint64_t dataSize;
+};
+
+static std::mutex cache_mutex;
+
+static fs::path
+cacheFolder()
+{
+    if (!settings.rawCacheFolder.empty()) {
+        return fs::path(settings.rawCacheFolder);
+    }
+    return fs::temp_directory_path() / kCacheDir;
+}
+
+// Source path, size and modification time, empty if the file cannot be stat'ed
+static std::string
+cacheKey(const std::string& srcFile)
+{
+    std::error_code ec;
+    fs::path src   = fs::absolute(srcFile, ec);
+    uintmax_t size = fs::file_size(src, ec);
+    if (ec) {
+        return "";
+    }
+    auto mtime = fs::last_write_time(src, ec);
+    if (ec) {
+        return "";
+    }
+    return src.generic_string() + "|" + std::to_string(size) + "|"
+           + std::to_string(mtime.time_since_epoch().count());
+}
+
+// FNV-1a 64 of the key
+static fs::path
+cacheFile(const std::string& key)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned char c : key) {
+        hash ^= c;
+        hash *= 0x100000001b3ULL;
+    }
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << hash << kCacheExt;
+    return cacheFolder() / name.str();
+}
+
+static bool
+rawLayout(const libraw_rawdata_t& rawdata, uint32_t& layout, const void*& data)
+{
+    if (rawdata.raw_image) {
+        layout = Bayer, data = rawdata.raw_image;
+    } else if (rawdata.color4_image) {
+        layout = Color4, data = rawdata.color4_image;
+    } else if (rawdata.color3_image) {
+        layout = Color3, data = rawdata.color3_image;
+    } else if (rawdata.float_image) {
+        layout = Float1, data = rawdata.float_image;
+    } else if (rawdata.float3_image) {
+        layout = Float3, data = rawdata.float3_image;
+    } else if (rawdata.float4_image) {
+        layout = Float4, data = rawdata.float4_image;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static void
+setLayout(libraw_rawdata_t& rawdata, uint32_t layout, void* data)
+{
+    switch (layout) {
+    case Bayer: rawdata.raw_image = static_cast<ushort*>(data); break;
+    case Color4: rawdata.color4_image = static_cast<ushort(*)[4]>(data); break;
+    case Color3: rawdata.color3_image = static_cast<ushort(*)[3]>(data); break;
+    case Float1: rawdata.float_image = static_cast<float*>(data); break;
+    case Float3: rawdata.float3_image = static_cast<float(*)[3]>(data); break;
+    case Float4: rawdata.float4_image = static_cast<float(*)[4]>(data); break;
+    }
+}
+
+static void
+fillHeader(CacheHeader& header)
+{
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version       = kCacheVersion;
+    header.librawVersion = LIBRAW_VERSION;
+    header.sizesSize     = sizeof(libraw_image_sizes_t);
+    header.iparamsSize   = sizeof(libraw_iparams_t);
+    header.ioparamsSize  = sizeof(libraw_internal_output_params_t);
+    header.colorSize     = sizeof(libraw_colordata_t);
+}
+
+// Removes least recently used entries until the folder fits into the size cap
+static void
+trimCache(const fs::path& folder)
+{
+    const uintmax_t cap = uintmax_t(settings.rawCacheSize) << 20;
+    if (cap == 0) {
+        return;
+    }
+
+    struct Entry {
+        fs::path path;
+        uintmax_t size;
+        fs::file_time_type time;
+    };
+    std::vector<Entry> entries;
+    uintmax_t total = 0;
+
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(folder, ec)) {
+        if (!entry.is_regular_file(ec) || entry.path().extension() != kCacheExt) {
+            continue;
+        }
+        Entry e { entry.path(), entry.file_size(ec), entry.last_write_time(ec) };
+        total += e.size;
+        entries.push_back(std::move(e));
+    }
+    if (total <= cap) {
+        return;
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.time < b.time; });
+    for (const auto& e : entries) {
+        if (total <= cap) {
+            break;
+        }
+        if (fs::remove(e.path, ec)) {
+            spdlog::debug("RawCache: Evicted {}", e.path.filename().string());
+            total -= e.size;
+        }
+    }
+}
+
+bool
+rawCacheLoad(LibRaw* raw, const std::string& srcFile)
+{
+    std::string key = cacheKey(srcFile);
+    if (key.empty()) {
+        return false;
+    }
+    fs::path file = cacheFile(key);
+
+    std::ifstream in(file, std::ios::binary);
+    if (!in) {
+        spdlog::debug("RawCache: Miss {}", srcFile);
+        return false;
+    }
+
+    CacheHeader header, expected;
+    fillHeader(expected);
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!in || std::memcmp(header.magic, expected.magic, sizeof(kMagic)) != 0 || header.version != expected.version
+        || header.librawVersion != expected.librawVersion || header.sizesSize != expected.sizesSize
+        || header.iparamsSize != expected.iparamsSize || header.ioparamsSize != expected.ioparamsSize
+        || header.colorSize != expected.colorSize || header.layout > Float4 || header.keySize > kMaxKeySize) {
+        spdlog::warn("RawCache: Incompatible entry for {}", srcFile);
+        return false;
+    }
+
+    std::string stored(header.keySize, '\0');
+    in.read(stored.data(), header.keySize);
+    if (!in || stored != key) {
+        spdlog::debug("RawCache: Stale entry for {}", srcFile);
+        return false;
+    }
+
+    // colordata is large (tone curve and black level tables), keep it off the stack
+    auto sizes    = std::make_unique<libraw_image_sizes_t>();
+    auto iparams  = std::make_unique<libraw_iparams_t>();
+    auto ioparams = std::make_unique<libraw_internal_output_params_t>();
+    auto color    = std::make_unique<libraw_colordata_t>();
+    in.read(reinterpret_cast<char*>(sizes.get()), sizeof(*sizes));
+    in.read(reinterpret_cast<char*>(iparams.get()), sizeof(*iparams));
+    in.read(reinterpret_cast<char*>(ioparams.get()), sizeof(*ioparams));
+    in.read(reinterpret_cast<char*>(color.get()), sizeof(*color));
+    if (!in || header.dataSize != uint64_t(sizes->raw_pitch) * sizes->raw_height) {
+        spdlog::warn("RawCache: Corrupted entry for {}", srcFile);
+        return false;
+    }
+
+    // LibRaw frees raw_alloc itself, so the data goes into its own allocation (with the same spare rows unpack() adds)
+    void* data = raw->malloc(header.dataSize + size_t(sizes->raw_pitch) * 8);
+    if (!data) {
+        return false;
+    }
+    in.seekg(header.dataOffset);
+    in.read(static_cast<char*>(data), header.dataSize);
+    if (!in) {
+        spdlog::warn("RawCache: Cannot read entry for {}", srcFile);
+        raw->free(data);
+        return false;
+    }
+
+    auto& imgdata = raw->imgdata;
+    auto& rawdata = imgdata.rawdata;
+
+    // pointers belong to the freshly opened file, the stored ones are stale
+    void* profile = imgdata.color.profile;
+    char* xmpdata = imgdata.idata.xmpdata;
+
+    rawdata.sizes    = *sizes;
+    rawdata.iparams  = *iparams;
+    rawdata.ioparams = *ioparams;
+    rawdata.color    = *color;
+
+    rawdata.color.profile   = profile;
+    rawdata.iparams.xmpdata = xmpdata;
+
+    imgdata.sizes = rawdata.sizes;
+    imgdata.idata = rawdata.iparams;
+    imgdata.color = rawdata.color;
+
+    rawdata.raw_alloc = data;
+    setLayout(rawdata, header.layout, data);
+    imgdata.progress_flags |= LIBRAW_PROGRESS_LOAD_RAW;
+
+    // last write time is the LRU stamp
+    std::error_code ec;
+    fs::last_write_time(file, fs::file_time_type::clock::now(), ec);
+
+    spdlog::debug("RawCache: Hit {} ({:.1f} MB)", srcFile, header.dataSize / 1048576.0);
+    return true;
+}
+
+bool
+rawCacheStore(const LibRaw* raw, const std::string& srcFile)
+{
+    const auto& rawdata = raw->imgdata.rawdata;
+
+    // Phase One black level tables live outside of the stored structures
+    if (rawdata.ph1_cblack || rawdata.ph1_rblack) {
+        spdlog::debug("RawCache: Not cacheable {}", srcFile);
+        return false;
+    }
+
+    uint32_t layout;
+    const void* data;
+    if (!rawLayout(rawdata, layout, data)) {
+        return false;
+    }
+
+    std::string key = cacheKey(srcFile);
+    if (key.empty()) {
+        return false;
+    }
+
+    fs::path folder = cacheFolder();
+    std::error_code ec;
+    fs::create_directories(folder, ec);
+    if (ec) {
+        spdlog::error("RawCache: Cannot create cache folder: {}", folder.string());
+        return false;
+    }
+
+    CacheHeader header;
+    fillHeader(header);
+    header.layout   = layout;
+    header.keySize  = key.size();
+    header.dataSize = uint64_t(rawdata.sizes.raw_pitch) * rawdata.sizes.raw_height;
+
+    uint64_t offset = sizeof(header) + key.size() + sizeof(rawdata.sizes) + sizeof(rawdata.iparams)
+                      + sizeof(rawdata.ioparams) + sizeof(rawdata.color);
+    header.dataOffset = (offset + kDataAlign - 1) / kDataAlign * kDataAlign;
+
+    // written under a per thread name and renamed, so readers never see a partial entry
+    fs::path file = cacheFile(key);
+    fs::path temp = file;
+    temp += "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(key.data(), key.size());
+        out.write(reinterpret_cast<const char*>(&rawdata.sizes), sizeof(rawdata.sizes));
+        out.write(reinterpret_cast<const char*>(&rawdata.iparams), sizeof(rawdata.iparams));
+        out.write(reinterpret_cast<const char*>(&rawdata.ioparams), sizeof(rawdata.ioparams));
+        out.write(reinterpret_cast<const char*>(&rawdata.color), sizeof(rawdata.color));
+        std::vector<char> pad(header.dataOffset - offset, 0);
+        out.write(pad.data(), pad.size());
+        out.write(static_cast<const char*>(data), header.dataSize);
+        if (!out) {
+            out.close();
+            fs::remove(temp, ec);
+            spdlog::error("RawCache: Cannot write cache entry for {}", srcFile);
+            return false;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    fs::rename(temp, file, ec);
+    if (ec) {
+        fs::remove(temp, ec);
+        return false;
+    }
+    spdlog::debug("RawCache: Stored {} ({:.1f} MB)", srcFile, header.dataSize / 1048576.0);
+
+    trimCache(folder);
+    return true;
+}
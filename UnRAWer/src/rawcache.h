@@ -0,0 +1,40 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#ifndef RAWCACHE_H
+#    define RAWCACHE_H
+
+#    include <string>
+
+class LibRaw;  // forward declaration
+
+// On-disk cache of unpacked raw data, keyed by source path, size and modification time.
+// Entries are uncompressed with page aligned pixel data; the cache folder is trimmed to
+// settings.rawCacheSize (least recently used entries go first).
+
+// Hydrates an opened LibRaw instance from the cache instead of calling unpack().
+// Returns false on a cache miss or a stale/incompatible entry.
+bool
+rawCacheLoad(LibRaw* raw, const std::string& srcFile);
+
+// Stores the unpacked raw data of srcFile, must be called right after unpack()
+bool
+rawCacheStore(const LibRaw* raw, const std::string& srcFile);
+
+#endif  // !RAWCACHE_H
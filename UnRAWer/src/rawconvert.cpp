@@ -0,0 +1,182 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "pch.h"
+
+#include "rawconvert.h"
+#include "imageio.h"
+
+#include <OpenImageIO/imagebufalgo_util.h>
+
+// Output tile size for the transposing orientations (5, 6)
+static constexpr int kBlock = 64;
+
+struct FusedParams {
+    const ushort (*img)[4];
+    int iwidth, iheight;
+    int flip;
+    int nch;       // output channels
+    float scale;   // 16bit linear value -> [0, 1]
+};
+
+// LibRaw::flip_index() for output (row, col)
+static inline size_t
+flipIndex(const FusedParams& p, int row, int col)
+{
+    if (p.flip & 4)
+        std::swap(row, col);
+    if (p.flip & 2)
+        row = p.iheight - 1 - row;
+    if (p.flip & 1)
+        col = p.iwidth - 1 - col;
+    return size_t(row) * p.iwidth + col;
+}
+
+template<typename T>
+static inline T
+storeValue(float v)
+{
+    return T(v);
+}
+
+template<>
+inline uint8_t
+storeValue<uint8_t>(float v)
+{
+    return uint8_t(v * 255.0f + 0.5f);
+}
+
+template<>
+inline uint16_t
+storeValue<uint16_t>(float v)
+{
+    return uint16_t(v * 65535.0f + 0.5f);
+}
+
+template<typename T>
+static void
+convertBlock(const FusedParams& p, ImageBuf& dst, ROI roi)
+{
+    char* base          = reinterpret_cast<char*>(dst.localpixels());
+    const stride_t ystr = dst.scanline_stride();
+
+    for (int by = roi.ybegin; by < roi.yend; by += kBlock) {
+        const int bye = std::min(by + kBlock, roi.yend);
+        for (int bx = roi.xbegin; bx < roi.xend; bx += kBlock) {
+            const int bxe = std::min(bx + kBlock, roi.xend);
+            for (int y = by; y < bye; y++) {
+                T* out = reinterpret_cast<T*>(base + y * ystr) + size_t(bx) * p.nch;
+                for (int x = bx; x < bxe; x++) {
+                    const ushort* src = p.img[flipIndex(p, y, x)];
+                    for (int c = 0; c < p.nch; c++) {
+                        *out++ = storeValue<T>(std::min(src[c] * p.scale, 1.0f));
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Types without a specialized kernel are converted through a float scanline
+static void
+convertBlockGeneric(const FusedParams& p, ImageBuf& dst, ROI roi)
+{
+    const TypeDesc format = dst.spec().format;
+    std::vector<float> line(size_t(roi.width()) * p.nch);
+
+    for (int y = roi.ybegin; y < roi.yend; y++) {
+        float* out = line.data();
+        for (int x = roi.xbegin; x < roi.xend; x++) {
+            const ushort* src = p.img[flipIndex(p, y, x)];
+            for (int c = 0; c < p.nch; c++) {
+                *out++ = std::min(src[c] * p.scale, 1.0f);
+            }
+        }
+        convert_pixel_values(TypeDesc::FLOAT, line.data(), format, dst.pixeladdr(roi.xbegin, y), roi.width() * p.nch);
+    }
+}
+
+// White point the same way LibRaw's copy_mem_image() picks it before the linear gamma curve, from the
+// histogram convert_to_rgb() built in dcraw_process()
+static int
+autoWhite(const FusedLibRaw* raw)
+{
+    const auto& O         = raw->imgdata.params;
+    const auto& S         = raw->imgdata.sizes;
+    const auto* histogram = raw->histogram();
+    int t_white           = 0x2000;
+
+    if (!((O.highlight & ~2) || O.no_auto_bright) && histogram) {
+        int perc = int(S.width * S.height * O.auto_bright_thr);
+        if (raw->fujiWidth()) {
+            perc /= 2;
+        }
+        t_white = 0;
+        for (int c = 0; c < raw->imgdata.idata.colors; c++) {
+            int val, total;
+            for (val = 0x2000, total = 0; --val > 32;) {
+                if ((total += histogram[c][val]) > perc)
+                    break;
+            }
+            t_white = std::max(t_white, val);
+        }
+    }
+    return int((t_white << 3) / O.bright);
+}
+
+bool
+rawFusedConvert(FusedLibRaw* raw, TypeDesc out_format, ImageBuf& dst)
+{
+    const auto& S = raw->imgdata.sizes;
+
+    if (!raw->imgdata.image) {
+        spdlog::error("Fused: No demosaiced image data");
+        return false;
+    }
+
+    FusedParams p;
+    p.img       = raw->imgdata.image;
+    p.iwidth    = S.iwidth;
+    p.iheight   = S.iheight;
+    p.flip      = S.flip;
+    p.nch       = raw->imgdata.idata.colors == 1 ? 1 : 3;
+
+    const int white = autoWhite(raw);
+    // same mapping as LibRaw's linear gamma curve: min(0xffff, 0x10000 * v / white) / 0xffff
+    p.scale = white > 0 ? 65536.0f / (float(white) * 65535.0f) : 1.0f / 65535.0f;
+
+    const int out_w = (p.flip & 4) ? p.iheight : p.iwidth;
+    const int out_h = (p.flip & 4) ? p.iwidth : p.iheight;
+
+    spdlog::debug("Fused: {}x{}x{} flip {} white {} -> {}", out_w, out_h, p.nch, p.flip, white,
+                  formatText(out_format));
+
+    ImageSpec spec(out_w, out_h, p.nch, out_format);
+    dst.reset(spec, InitializePixels::No);
+
+    ImageBufAlgo::parallel_image(dst.roi(), [&](ROI roi) {
+        switch (out_format.basetype) {
+        case TypeDesc::UINT8: convertBlock<uint8_t>(p, dst, roi); break;
+        case TypeDesc::UINT16: convertBlock<uint16_t>(p, dst, roi); break;
+        case TypeDesc::HALF: convertBlock<half>(p, dst, roi); break;
+        case TypeDesc::FLOAT: convertBlock<float>(p, dst, roi); break;
+        default: convertBlockGeneric(p, dst, roi); break;
+        }
+    });
+
+    return true;
+}
@@ -0,0 +1,41 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#ifndef RAWCONVERT_H
+#    define RAWCONVERT_H
+
+#    include <OpenImageIO/imagebuf.h>
+
+#    include <libraw/libraw.h>
+
+// LibRaw with access to what copy_mem_image() reads from its internal data: the output histogram
+// convert_to_rgb() builds in dcraw_process() and the Fuji rotation flag
+class FusedLibRaw : public LibRaw {
+public:
+    const int (*histogram() const)[LIBRAW_HISTOGRAM_SIZE] { return libraw_internal_data.output_data.histogram; }
+    bool fujiWidth() const { return libraw_internal_data.internal_output_params.fuji_width != 0; }
+};
+
+// Converts LibRaw's processed image data (already in the output color space) straight into dst with out_format
+// pixels. LibRaw's linear white point scaling, orientation and type conversion are done in one cache-blocked
+// pass, the auto brightness white point comes from the histogram LibRaw built while converting colors.
+bool
+rawFusedConvert(FusedLibRaw* raw, OIIO::TypeDesc out_format, OIIO::ImageBuf& dst);
+
+#endif  // !RAWCONVERT_H
@@ -32,6 +32,16 @@ get_value(const toml::value& v, const std::string& section, const std::string& k
     }
 }
 
+// Same for keys of a table value (array of tables entries)
+template<typename T>
+void
+get_value(const toml::value& v, const std::string& key, T& var)
+{
+    if (v.contains(key)) {
+        var = toml::find<T>(v, key);
+    }
+}
+
 // Specialization or overload for handling type mismatches if necessary,
 // but toml11 usually handles conversions well for standard types.
 
@@ -44,7 +54,10 @@ loadSettings(Settings& settings, const std::string& filename)
         get_value(data, "Global", "Console", settings.conEnable);
         get_value(data, "Global", "Threads", settings.threads);
         get_value(data, "Global", "ThredsMult", settings.mltThreads);
+        get_value(data, "Global", "BufferPoolMB", settings.bufferPool);
+        get_value(data, "Global", "HugePages", settings.hugePages);
         get_value(data, "Global", "ExportSubf", settings.useSbFldr);
+        get_value(data, "Global", "GroupByPreset", settings.groupByPreset);
         get_value(data, "Global", "PathPrefix", settings.pathPrefix);
         get_value(data, "Global", "Verbosity", settings.verbosity);
 
@@ -54,15 +67,45 @@ loadSettings(Settings& settings, const std::string& filename)
         get_value(data, "Preview", "QueueMax", settings.previewQueueMax);
         get_value(data, "Preview", "MinTimeMs", settings.previewMinTimeMs);
 
+        get_value(data, "RawCache", "Enable", settings.rawCache);
+        get_value(data, "RawCache", "Folder", settings.rawCacheFolder);
+        get_value(data, "RawCache", "MaxSizeMB", settings.rawCacheSize);
+
         get_value(data, "Export", "DefaultFormat", settings.defFormat);
         get_value(data, "Export", "FileFormat", settings.fileFormat);
         get_value(data, "Export", "DefaultBit", settings.defBDepth);
         get_value(data, "Export", "BitDepth", settings.bitDepth);
+        get_value(data, "Export", "WorkingPrecision", settings.workPrecision);
         get_value(data, "Export", "Quality", settings.quality);
+        get_value(data, "Export", "TiffParallel", settings.tiffParallel);
+        get_value(data, "Export", "TiffCompression", settings.tiffCompression);
+        get_value(data, "Export", "TiffLevel", settings.tiffLevel);
+        get_value(data, "Export", "JpegParallel", settings.jpegParallel);
+        get_value(data, "Export", "HTJ2K", settings.htj2k);
+        get_value(data, "Export", "NativeEncoders", settings.nativeEncoders);
+        get_value(data, "Export", "EncoderThreads", settings.encodeThreads);
+        get_value(data, "Export", "JxlEffort", settings.jxlEffort);
+        get_value(data, "Export", "HeicPreset", settings.heicPreset);
+        get_value(data, "Export", "UnrwPlanar", settings.unrwPlanar);
+        get_value(data, "Export", "ExtraFormats", settings.extraFormats);
+        get_value(data, "Export", "Checksums", settings.checksums);
+        get_value(data, "Export", "Manifest", settings.manifest);
+        get_value(data, "Export", "PyramidLevels", settings.pyramidLevels);
+        get_value(data, "Export", "PyramidMode", settings.pyramidMode);
+
+        get_value(data, "Compression", "Profile", settings.compProfile);
+        get_value(data, "Compression", "TIFF", settings.formatProfile[0]);
+        get_value(data, "Compression", "EXR", settings.formatProfile[1]);
+        get_value(data, "Compression", "PNG", settings.formatProfile[2]);
+        get_value(data, "Compression", "JXL", settings.formatProfile[5]);
+        get_value(data, "Compression", "HEIC", settings.formatProfile[6]);
 
         get_value(data, "CameraRaw", "RawRotation", settings.rawRot);
         get_value(data, "CameraRaw", "RawColorSpace", settings.rawSpace);
         get_value(data, "CameraRaw", "Demosaic", settings.dDemosaic);
+        get_value(data, "CameraRaw", "fused_convert", settings.fusedConvert);
+        get_value(data, "CameraRaw", "proxy_mode", settings.proxyMode);
+        get_value(data, "CameraRaw", "orientation_metadata", settings.orientMeta);
         get_value(data, "CameraRaw", "half_size", settings.rawParms.half_size);
         get_value(data, "CameraRaw", "use_auto_wb", settings.rawParms.use_auto_wb);
         get_value(data, "CameraRaw", "use_camera_wb", settings.rawParms.use_camera_wb);
@@ -87,15 +130,38 @@ loadSettings(Settings& settings, const std::string& filename)
 
         get_value(data, "Transform", "LutFolder", settings.lutFolder);
         get_value(data, "Transform", "LutTransform", settings.lutMode);
+        get_value(data, "Transform", "LutEngine", settings.lutEngine);
         get_value(data, "Transform", "LutDefault", settings.dLutPreset);
         get_value(data, "Transform", "exif_lut", settings.perCamera);
+        get_value(data, "Transform", "exif_lut_fallback", settings.cameraLutFallback);
 
         get_value(data, "Unsharp", "sharp_mode", settings.sharp_mode);
+        get_value(data, "Unsharp", "sharp_engine", settings.sharpEngine);
         get_value(data, "Unsharp", "sharp_kernel", settings.sharp_kernel);
+        get_value(data, "Unsharp", "sharp_tiled", settings.tiledProcess);
         get_value(data, "Unsharp", "sharp_width", settings.sharp_width);
         get_value(data, "Unsharp", "sharp_contrast", settings.sharp_contrast);
         get_value(data, "Unsharp", "sharp_treshold", settings.sharp_tresh);
 
+        // Output variants, array of [[Variant]] tables
+        settings.variants.clear();
+        if (data.contains("Variant")) {
+            for (const auto& v : toml::find(data, "Variant").as_array()) {
+                OutputVariant variant;
+                get_value(v, "Suffix", variant.suffix);
+                get_value(v, "FileFormat", variant.fileFormat);
+                get_value(v, "BitDepth", variant.bitDepth);
+                get_value(v, "LutPreset", variant.lutPreset);
+                get_value(v, "Scale", variant.scale);
+
+                if (variant.suffix.empty()) {
+                    variant.suffix = "_v" + std::to_string(settings.variants.size() + 1);
+                }
+                variant.scale = std::clamp(variant.scale, 0.01f, 1.0f);
+                settings.variants.push_back(variant);
+            }
+        }
+
         // Scan LUT folder
         namespace fs = std::filesystem;
         fs::path lutPath(settings.lutFolder);
@@ -125,6 +191,8 @@ printSettings(Settings& settings)
     spdlog::info("--- Current Settings ---");
     spdlog::info("Console: {}", settings.conEnable);
     spdlog::info("Threads: {}", settings.threads);
+    spdlog::info("Group by preset: {}", settings.groupByPreset);
+    spdlog::info("Buffer pool: {} MB{}", settings.bufferPool, settings.hugePages ? ", huge pages" : "");
     spdlog::info("Verbosity: {}", settings.verbosity);
     spdlog::info("Preview Enable: {}", settings.previewEnable);
     spdlog::info("Preview QueueMax: {}", settings.previewQueueMax);
@@ -132,17 +200,84 @@ printSettings(Settings& settings)
     spdlog::info("Range Mode: {}", settings.rangeMode);
     spdlog::info("Export Format: {}", settings.fileFormat);
     spdlog::info("Bit Depth: {}", settings.bitDepth);
+    spdlog::info("Working Precision: {}", settings.workPrecision);
     spdlog::info("Quality: {}", settings.quality);
+    spdlog::info("TIFF Parallel: {}", settings.tiffParallel);
+    spdlog::info("TIFF Compression: {} Level: {}", settings.tiffCompression, settings.tiffLevel);
+    spdlog::info("JPEG Parallel: {}", settings.jpegParallel);
+    spdlog::info("HTJ2K: {}", settings.htj2k);
+    spdlog::info("Native JXL/HEIC: {} Threads: {} JXL Effort: {} HEIC Preset: {}", settings.nativeEncoders,
+                 settings.encodeThreads, settings.jxlEffort, settings.heicPreset);
+    spdlog::info("UNRW Planar: {}", settings.unrwPlanar);
+    std::string extraFormats;
+    for (int format : settings.extraFormats) {
+        extraFormats += (extraFormats.empty() ? "" : ", ") + std::to_string(format);
+    }
+    spdlog::info("Extra Formats: [{}]", extraFormats);
+    spdlog::info("Checksums: {} Manifest: {}", settings.checksums, settings.manifest);
+    spdlog::info("Pyramid Levels: {} Mode: {}", settings.pyramidLevels, settings.pyramidMode);
+    spdlog::info("Compression Profile: {} TIFF: {} EXR: {} PNG: {} JXL: {} HEIC: {}", settings.compProfile,
+                 settings.formatProfile[0], settings.formatProfile[1], settings.formatProfile[2],
+                 settings.formatProfile[5], settings.formatProfile[6]);
+    for (const auto& variant : settings.variants) {
+        spdlog::info("Variant {}: Format: {} Bit Depth: {} LUT: {} Scale: {}", variant.suffix, variant.fileFormat,
+                     variant.bitDepth, variant.lutPreset, variant.scale);
+    }
 
     spdlog::info("Raw Rotation: {}", settings.rawRot);
+    spdlog::info("Orientation Metadata: {}", settings.orientMeta);
     spdlog::info("Raw Color Space: {}", settings.rawSpace);
     spdlog::info("Demosaic: {}", settings.dDemosaic);
+    spdlog::info("Fused Convert: {}", settings.fusedConvert);
+    spdlog::info("Proxy Mode: {}", settings.proxyMode);
+    spdlog::info("Raw Cache: {} Folder: {} Max Size: {} MB", settings.rawCache, settings.rawCacheFolder,
+                 settings.rawCacheSize);
 
     spdlog::info("Auto WB: {}", settings.rawParms.use_auto_wb);
     spdlog::info("Camera WB: {}", settings.rawParms.use_camera_wb);
 
     spdlog::info("OCIO Config: {}", settings.ocioConfigPath);
     spdlog::info("LUT Mode: {}", settings.lutMode);
+    spdlog::info("LUT Engine: {}", settings.lutEngine == 1 ? "native" : "OCIO");
+    spdlog::info("Per camera LUT: {} fallback: {}", settings.perCamera, settings.cameraLutFallback);
     spdlog::info("Sharp Mode: {}", settings.sharp_mode);
+    spdlog::info("Sharp Engine: {}", settings.sharpEngine == 1 ? "native" : "OIIO");
+    spdlog::info("Tiled processing: {}", settings.tiledProcess);
     spdlog::info("------------------------");
 }
+
+bool
+setCompressionProfile(Settings& settings, const std::string& value)
+{
+    std::string format, name = value;
+    if (auto colon = value.find(':'); colon != std::string::npos) {
+        format = value.substr(0, colon);
+        name   = value.substr(colon + 1);
+    }
+    std::transform(format.begin(), format.end(), format.begin(), [](unsigned char c) { return std::tolower(c); });
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+
+    int profile = -1;
+    if (name != "custom") {
+        auto it = std::find(std::begin(settings.compProfiles), std::end(settings.compProfiles), name);
+        if (it == std::end(settings.compProfiles)) {
+            return false;
+        }
+        profile = static_cast<int>(it - std::begin(settings.compProfiles));
+    }
+
+    if (format.empty()) {
+        settings.compProfile = profile;
+        std::fill(std::begin(settings.formatProfile), std::end(settings.formatProfile), -1);
+        return true;
+    }
+    static const std::map<std::string, int> formats = {
+        { "tiff", 0 }, { "tif", 0 }, { "exr", 1 }, { "png", 2 }, { "jxl", 5 }, { "heic", 6 }
+    };
+    auto f = formats.find(format);
+    if (f == formats.end()) {
+        return false;
+    }
+    settings.formatProfile[f->second] = profile;
+    return true;
+}
@@ -20,6 +20,8 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <algorithm>
+#include <iterator>
 
 #ifndef SETTINGS_H
 #define SETTINGS_H
@@ -29,6 +31,15 @@ typedef unsigned short ushort;
 typedef unsigned int uint;
 typedef unsigned long ulong;
 
+// Additional output rendered from the same decoded raw, declared as [[Variant]] tables in the config
+struct OutputVariant {
+	std::string suffix;		// Output file name suffix, added after the LUT preset suffix
+	int fileFormat = -1;	// -1 - same as the main export, otherwise Export.FileFormat values
+	int bitDepth = -1;		// -1 - same as the main export, otherwise Export.BitDepth values
+	std::string lutPreset;	// "" - same preset as the main export, "none" - no LUT
+	float scale = 1.0f;		// Output scale, 1.0 - full resolution
+};
+
 struct Settings {
     // UI state
     bool show_settings_window = true;
@@ -39,23 +50,54 @@ struct Settings {
     int previewMinTimeMs;     // Minimum time per preview frame
 
 	bool conEnable, useSbFldr, perCamera;
+	int cameraLutFallback;
+	bool groupByPreset;
 	std::string pathPrefix;
 
 	uint rangeMode;
-	int crop_mode, lutMode, sharp_mode;
+	int crop_mode, lutMode, lutEngine, sharp_mode, sharpEngine;
+	bool tiledProcess;
 	uint denoise_mode;
 	int fileFormat, defFormat;
 	int bitDepth, defBDepth;
+	int workPrecision;
 	int quality;
+	bool tiffParallel;
+	std::string tiffCompression;
+	int tiffLevel;
+	bool jpegParallel;
+	bool htj2k;
+	bool nativeEncoders;
+	int encodeThreads;
+	int jxlEffort;
+	std::string heicPreset;
+	bool unrwPlanar;
+	int pyramidLevels;
+	int pyramidMode;
+	int compProfile;
+	int formatProfile[8];	// per Export.FileFormat, -1 - compProfile
 	int rawRot;
 	uint rawSpace, threads;
 	int dDemosaic;
+	bool fusedConvert;
+	bool proxyMode;
+	bool orientMeta;
+	bool rawCache;
+	std::string rawCacheFolder;
+	uint rawCacheSize;		// MB
 	float mltThreads;
+	uint bufferPool;		// MB
+	bool hugePages;
 	uint verbosity;
 
-	std::vector<std::string> out_formats = { "tif", "exr", "png", "jpg", "jp2", "jxl", "heic", "ppm"};
+	std::vector<std::string> out_formats = { "tif", "exr", "png", "jpg", "jp2", "jxl", "heic", "ppm", "unrw"};
 	std::string ocioConfigPath, dLutPreset;
 	
+	std::vector<OutputVariant> variants;
+	std::vector<int> extraFormats;
+	bool checksums;
+	std::string manifest;
+
 	std::map<std::string, std::string> lut_Preset;
 	std::string lutFolder;
 	const std::string sharp_kerns[13] = {"gaussian", "sharp-gaussian", "box", "triangle",
@@ -67,8 +109,9 @@ struct Settings {
 	float sharp_tresh;
 
 	const int raw_rot[5] = { -1, 0, 3, 5, 6 }; // -1 - Auto EXIF, 0 - Unrotated/Horisontal, 3 - 180 Horisontal, 5 - 90 CW Vertical, 6 - 90 CCW Vertical
-	const uint rngConv[4] = { 0, 1, 2, 3}; // 0 - unsigned, 1 - signed, 2 - unsigned -> signed, 3 - signed -> unsigned
+	const uint rngConv[4] = { 0, 1, 2, 3}; // 0 - unsigned, 1 - signed, 2 - signed -> unsigned, 3 - unsigned -> signed
 	const std::string rawCspace[11] = { "Raw", "sRGB", "sRGB-linear", "Adobe", "Wide", "ProPhoto", "ProPhoto-linear", "XYZ", "ACES", "DCI-P3", "Rec2020" };
+	const std::string compProfiles[3] = { "fast", "balanced", "small" };
 	const std::string demosaic[15] = { "raw data", "none", "linear", "VNG", "PPG", "AHD", "DCB", "", "", "", "", "", "", "DHT", "AAHD"};
 
 	struct rawparms {
@@ -94,6 +137,7 @@ struct Settings {
 	void reSettings() {
 		conEnable = true;	// Console enabled/disabled
 		useSbFldr = false;	// Use subfolder for output
+		groupByPreset = false;	// Reorder files so that files with the same LUT run together
 		pathPrefix = "";	// Path prefix for output
 		verbosity = 3;		// Verbosity level: 0 - none, 1 - errors, 2 - warnings, 3 - info, 4 - debug, 5 - trace
 
@@ -102,25 +146,57 @@ struct Settings {
         previewMinTimeMs = 1000;
 
 		lutMode = 0;		// LUT mode: -1 - disabled, 0 - Smart, 1 - Force
+		lutEngine = 0;		// LUT engine: 0 - OCIO, 1 - native tetrahedral for .cube/.3dl
+		cameraLutFallback = 0;	// Camera without a per camera LUT: 0 - preset LUT, 1 - no LUT, 2 - skip the file
 		lutFolder = "";		// LUT folder
 		crop_mode = 0;		// Crop mode: -1 - disabled, 0 - Smart, 1 - Force
 		dLutPreset = "";	// Default LUT preset, top one
 
 		threads = 5;		// Number of threads: 0 - auto, >0 - number of threads
-		rangeMode = 0;		// Float type: 0 - unsigned, 1 - signed, 2 - unsigned -> signed, 3 - signed -> unsigned
-		fileFormat = -1;	// File format: -1 - original, 0 - TIFF, 1 - OpenEXR, 2 - PNG, 3 - JPEG, 4 - JPEG-2000, 5 - JPEG-XL, 6 - HEIC, 7 - PPM
+		bufferPool = 2048;	// Idle scratch image buffers kept between files, MB, 0 - no pooling
+		hugePages = false;	// Back scratch image buffers by 2 MB pages
+		rangeMode = 0;		// Float type: 0 - unsigned, 1 - signed, 2 - signed -> unsigned, 3 - unsigned -> signed
+		fileFormat = -1;	// File format: -1 - original, 0 - TIFF, 1 - OpenEXR, 2 - PNG, 3 - JPEG, 4 - JPEG-2000, 5 - JPEG-XL, 6 - HEIC, 7 - PPM, 8 - UNRW
 		defFormat = 0;		// Default file format = TIFF
 		bitDepth = -1;		// Bit depth: -1 - Original, 0 - uint8, 1 - uint16, 2 - uint32, 3 - uint64, 4 - half, 5 - float, 6 - double
 		defBDepth = 1;		// Default bit depth = uint16
+		workPrecision = -1;	// LUT/unsharp working format: -1 - output format, 0 - half, 1 - float, 2 - uint16
 		quality = 100;		// JPEG quality
+		tiffParallel = false;	// Compress TIFF strips concurrently (opt-in)
+		tiffCompression = "zip";	// TIFF compression: none, zip, zstd, lzw
+		tiffLevel = 9;		// TIFF zip/zstd compression level
+		jpegParallel = false;	// Encode JPEG stripes concurrently, joined with restart markers (opt-in)
+		htj2k = false;		// JPEG-2000 output as an HTJ2K .j2c codestream (OpenJPH)
+		nativeEncoders = false;	// JXL/HEIC through libjxl/libheif with an explicit thread count (opt-in)
+		encodeThreads = 0;	// JXL/HEIC encoder threads per file: 0 - cores / writer threads
+		jxlEffort = 7;		// JXL effort 1-9
+		heicPreset = "medium";	// x265 preset of HEIC output
+		unrwPlanar = true;	// UNRW image layout: true - planar, false - interleaved
+		pyramidLevels = 0;	// Extra 1/2, 1/4, ... resolution levels written with every file, 0 - off
+		pyramidMode = 0;	// Pyramid levels: 0 - separate files with _2, _4, ... suffixes, 1 - subimages of one TIFF/EXR
+		compProfile = -1;	// Compression profile: -1 - custom, 0 - fast, 1 - balanced, 2 - small
+		std::fill(std::begin(formatProfile), std::end(formatProfile), -1);
+		variants.clear();	// No additional output variants
+		extraFormats.clear();	// No extra formats of the main export
+		checksums = false;	// XXH64 of every output in a JSON lines manifest
+		manifest = "unrawer_manifest.jsonl";	// Manifest file, a relative name is kept in each output folder
 		
 		rawRot = -1;		// Raw rotation: -1 - Auto EXIF, 0 - Unrotated/Horisontal, 3 - 180 Horisontal, 5 - 90 CCW Vertical, 6 - 90 CW Vertical
 		rawSpace = 1;
 		dDemosaic = 5;
+		fusedConvert = false;	// Single pass white scaling + output conversion instead of LibRaw's mem image
+		proxyMode = false;		// Export the embedded camera preview instead of decoding raw data
+		orientMeta = false;		// Write rotation as the Exif Orientation tag instead of rotating pixels
+
+		rawCache = false;		// On-disk cache of unpacked raw data
+		rawCacheFolder = "";	// Cache folder, "" - system temp folder
+		rawCacheSize = 8192;	// Cache size cap in MB, 0 - unlimited
 		
 		ocioConfigPath = "";
 
 		sharp_mode = 1;		// Sharpening mode: -1 - disabled, 0 - Smart, 1 - Force
+		sharpEngine = 0;	// Sharpening engine: 0 - OIIO, 1 - native separable (gaussian, box, binomial, median)
+		tiledProcess = false;	// LUT, unsharp and output format conversion in one tiled pass
 		sharp_kernel = 0;
 		sharp_width = 3.0f;
 		sharp_contrast = 0.5f;
@@ -168,4 +244,6 @@ extern Settings settings;
 
 bool loadSettings(Settings& settings, const std::string& filename);
 void printSettings(Settings& settings);
+// "fast", "balanced", "small" or "custom" for all formats, or "<format>:<profile>" (tiff, exr, png, jxl, heic)
+bool setCompressionProfile(Settings& settings, const std::string& value);
 #endif
@@ -0,0 +1,329 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "pch.h"
+
+#include "sharpen.h"
+#include "settings.h"
+
+#include <OpenImageIO/imagebufalgo.h>
+
+using namespace OIIO;
+
+// Median windows up to this size are sorted directly, larger ones use a sliding histogram
+static constexpr int kSmallMedian = 5;
+
+// Odd kernel size for a filter width, same rounding as OIIO's make_kernel
+static int
+kernelSize(float width)
+{
+    int size = std::max(1, static_cast<int>(std::ceil(width)));
+    return (size & 1) ? size : size + 1;
+}
+
+// Normalized 1D weights of a separable kernel, sampled like OIIO's 2D filters
+static bool
+makeWeights(const std::string& kernel, float width, std::vector<float>& weights)
+{
+    const int size   = kernelSize(width);
+    const int radius = size / 2;
+    weights.assign(size, 0.0f);
+
+    if (kernel == "gaussian") {
+        const float inv = 2.0f / width;
+        for (int i = 0; i < size; i++) {
+            float x    = std::abs(i - radius) * inv;
+            weights[i] = x < 1.0f ? std::exp(-2.0f * x * x) : 0.0f;
+        }
+    } else if (kernel == "box") {
+        for (int i = 0; i < size; i++) {
+            weights[i] = std::abs(i - radius) <= width * 0.5f ? 1.0f : 0.0f;
+        }
+    } else if (kernel == "binomial") {
+        // row of Pascal's triangle
+        weights[0] = 1.0f;
+        for (int i = 1; i < size; i++) {
+            weights[i] = weights[i - 1] * (size - i) / i;
+        }
+    } else {
+        return false;
+    }
+
+    float sum = 0.0f;
+    for (float w : weights) {
+        sum += w;
+    }
+    if (sum <= 0.0f) {
+        return false;
+    }
+    for (float& w : weights) {
+        w /= sum;
+    }
+    return true;
+}
+
+// Full width source rows as float, padded by radius pixels on each side with the edge pixels.
+// Rows outside the image are clamped to the first/last row.
+class RowRing {
+public:
+    RowRing(const ImageBuf& src, int radius)
+        : m_src(src)
+        , m_full(src.roi())
+        , m_nch(src.nchannels())
+        , m_radius(radius)
+        , m_stride(size_t(m_full.width() + 2 * radius) * m_nch)
+        , m_rows(2 * radius + 1)
+        , m_data(m_stride * m_rows)
+    {
+    }
+
+    // Reads image row y into its ring slot
+    bool load(int y)
+    {
+        float* row = slot(y);
+        int sy     = std::clamp(y, m_full.ybegin, m_full.yend - 1);
+        ROI line(m_full.xbegin, m_full.xend, sy, sy + 1, m_full.zbegin, m_full.zbegin + 1, 0, m_nch);
+        if (!m_src.get_pixels(line, TypeDesc::FLOAT, row + size_t(m_radius) * m_nch)) {
+            return false;
+        }
+        const float* first = row + size_t(m_radius) * m_nch;
+        const float* last  = row + (m_stride - size_t(m_radius + 1) * m_nch);
+        for (int i = 0; i < m_radius; i++) {
+            std::copy(first, first + m_nch, row + size_t(i) * m_nch);
+            std::copy(last, last + m_nch, row + m_stride - size_t(i + 1) * m_nch);
+        }
+        return true;
+    }
+
+    int index(int y) const
+    {
+        int s = y % m_rows;
+        return s < 0 ? s + m_rows : s;
+    }
+
+    float* slot(int y) { return m_data.data() + size_t(index(y)) * m_stride; }
+
+    size_t stride() const { return m_stride; }
+
+private:
+    const ImageBuf& m_src;
+    ROI m_full;
+    int m_nch;
+    int m_radius;
+    size_t m_stride;
+    int m_rows;
+    std::vector<float> m_data;
+};
+
+// Median of a channel over the window rows, histogram of quantized values slid along the row.
+// Values come from 8/16bit pixels so value * maxval is an exact integer.
+static void
+medianRowHistogram(RowRing& ring, int y, int radius, int nch, int x0, int x1, int maxval, float* blur)
+{
+    const int bins   = maxval + 1;
+    const int blocks = (bins + 255) / 256;
+    const int count  = (2 * radius + 1) * (2 * radius + 1);
+    const int rank   = count / 2;
+    const float norm = 1.0f / maxval;
+
+    thread_local std::vector<uint32_t> fine, coarse;
+    fine.assign(bins, 0);
+    coarse.assign(blocks, 0);
+
+    auto bin = [maxval](float v) { return std::clamp(static_cast<int>(v * maxval + 0.5f), 0, maxval); };
+    auto column = [&](int c, int px, int delta) {
+        for (int dy = -radius; dy <= radius; dy++) {
+            int b = bin(ring.slot(y + dy)[size_t(px) * nch + c]);
+            fine[b] += delta;
+            coarse[b >> 8] += delta;
+        }
+    };
+
+    for (int c = 0; c < nch; c++) {
+        // padded column px covers image column px - radius, window of x is [x, x + 2 * radius]
+        for (int px = x0; px < x0 + 2 * radius; px++) {
+            column(c, px, 1);
+        }
+        for (int x = x0; x < x1; x++) {
+            column(c, x + 2 * radius, 1);
+
+            int acc = 0, block = 0;
+            while (acc + coarse[block] <= rank) {
+                acc += coarse[block++];
+            }
+            int b = block << 8;
+            while (acc + fine[b] <= rank) {
+                acc += fine[b++];
+            }
+            blur[size_t(x) * nch + c] = b * norm;
+
+            column(c, x, -1);
+        }
+        // empty the histogram for the next channel
+        for (int px = x1; px < x1 + 2 * radius; px++) {
+            column(c, px, -1);
+        }
+    }
+}
+
+// Median of a small window, sorted directly
+static void
+medianRowSmall(RowRing& ring, int y, int radius, int nch, int x0, int x1, float* blur)
+{
+    const int size = 2 * radius + 1;
+    float window[kSmallMedian * kSmallMedian];
+    const float* rows[kSmallMedian];
+    for (int dy = 0; dy < size; dy++) {
+        rows[dy] = ring.slot(y + dy - radius);
+    }
+    for (int x = x0; x < x1; x++) {
+        for (int c = 0; c < nch; c++) {
+            int n = 0;
+            for (int dy = 0; dy < size; dy++) {
+                for (int dx = 0; dx < size; dx++) {
+                    window[n++] = rows[dy][size_t(x + dx) * nch + c];
+                }
+            }
+            std::nth_element(window, window + n / 2, window + n);
+            blur[size_t(x) * nch + c] = window[n / 2];
+        }
+    }
+}
+
+bool
+nativeUnsharp(ImageBuf& dst, const ImageBuf& src, const std::string& kernel, float width, float contrast,
+              float threshold, ROI roi, int nthreads)
+{
+    const bool median = kernel == "median";
+    std::vector<float> weights;
+    if (!median && !makeWeights(kernel, width, weights)) {
+        return false;
+    }
+
+    const TypeDesc format = src.spec().format;
+    const int radius      = kernelSize(width) / 2;
+    int maxval            = 0;
+    if (median && radius * 2 + 1 > kSmallMedian) {
+        if (format == TypeDesc::UINT8) {
+            maxval = 255;
+        } else if (format == TypeDesc::UINT16) {
+            maxval = 65535;
+        } else {
+            return false;  // float data, OIIO's median filter
+        }
+    }
+
+    if (!dst.initialized()) {
+        dst.reset(src.spec(), InitializePixels::No);
+    }
+    const int nch  = src.nchannels();
+    const ROI full = src.roi();
+    if (!roi.defined()) {
+        roi = full;
+    }
+    roi.chbegin = 0;
+    roi.chend   = nch;
+
+    std::atomic<bool> ok { true };
+    ImageBufAlgo::parallel_image(roi, paropt(nthreads), [&](ROI chunk) {
+        RowRing ring(src, radius);
+        const size_t stride = ring.stride();
+        const int x0        = chunk.xbegin - full.xbegin;
+        const int x1        = chunk.xend - full.xbegin;
+
+        // horizontally blurred rows, same ring slots as the source rows
+        std::vector<float> hblur(median ? 0 : size_t(2 * radius + 1) * stride);
+        std::vector<float> blur(stride);
+        std::vector<float> out(size_t(chunk.width()) * nch);
+        auto hslot = [&](int y) { return hblur.data() + size_t(ring.index(y)) * stride; };
+
+        for (int yy = chunk.ybegin - radius; yy < chunk.yend + radius && ok; yy++) {
+            if (!ring.load(yy)) {
+                ok = false;
+                break;
+            }
+            if (!median) {
+                const float* in = ring.slot(yy);
+                float* h        = hslot(yy);
+                std::fill(h, h + stride, 0.0f);
+                const size_t n = size_t(x1 - x0) * nch;
+                for (int k = 0; k < 2 * radius + 1; k++) {
+                    const float w  = weights[k];
+                    const float* p = in + size_t(x0 + k) * nch;
+                    float* o       = h + size_t(x0) * nch;
+                    for (size_t i = 0; i < n; i++) {
+                        o[i] += w * p[i];
+                    }
+                }
+            }
+
+            const int y = yy - radius;
+            if (y < chunk.ybegin) {
+                continue;
+            }
+
+            if (median) {
+                if (maxval) {
+                    medianRowHistogram(ring, y, radius, nch, x0, x1, maxval, blur.data());
+                } else {
+                    medianRowSmall(ring, y, radius, nch, x0, x1, blur.data());
+                }
+            } else {
+                const size_t n = size_t(x1 - x0) * nch;
+                float* b       = blur.data() + size_t(x0) * nch;
+                std::fill(b, b + n, 0.0f);
+                for (int k = 0; k < 2 * radius + 1; k++) {
+                    const float w  = weights[k];
+                    const float* p = hslot(y + k - radius) + size_t(x0) * nch;
+                    for (size_t i = 0; i < n; i++) {
+                        b[i] += w * p[i];
+                    }
+                }
+            }
+
+            // source + contrast * (source - blur), differences under the threshold are dropped
+            const float* s = ring.slot(y) + size_t(x0 + radius) * nch;
+            const float* b = blur.data() + size_t(x0) * nch;
+            const size_t n = out.size();
+            if (threshold > 0.0f) {
+                for (size_t i = 0; i < n; i++) {
+                    float d = s[i] - b[i];
+                    out[i]  = std::abs(d) < threshold ? s[i] : s[i] + contrast * d;
+                }
+            } else {
+                for (size_t i = 0; i < n; i++) {
+                    out[i] = s[i] + contrast * (s[i] - b[i]);
+                }
+            }
+            ROI line(chunk.xbegin, chunk.xend, y, y + 1, chunk.zbegin, chunk.zbegin + 1, 0, nch);
+            if (!dst.set_pixels(line, TypeDesc::FLOAT, out.data())) {
+                ok = false;
+            }
+        }
+    });
+    return ok;
+}
+
+bool
+unsharpMask(ImageBuf& dst, const ImageBuf& src, const std::string& kernel, float width, float contrast,
+            float threshold, ROI roi, int nthreads)
+{
+    if (settings.sharpEngine == 1 && nativeUnsharp(dst, src, kernel, width, contrast, threshold, roi, nthreads)) {
+        return true;
+    }
+    return ImageBufAlgo::unsharp_mask(dst, src, kernel, width, contrast, threshold, roi, nthreads);
+}
@@ -0,0 +1,39 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#ifndef SHARPEN_H
+#    define SHARPEN_H
+
+#    include <OpenImageIO/imagebuf.h>
+
+#    include <string>
+
+// Native unsharp mask: separable gaussian/box/binomial blur streamed row by row through a small ring
+// of float rows, or a median blur (histogram based for 8/16bit images), with the threshold and
+// contrast applied while the output row is stored. Returns false for kernels it does not handle.
+bool
+nativeUnsharp(OIIO::ImageBuf& dst, const OIIO::ImageBuf& src, const std::string& kernel, float width, float contrast,
+              float threshold, OIIO::ROI roi = {}, int nthreads = 0);
+
+// Unsharp mask with the engine selected in settings, falls back to OIIO for other kernels
+bool
+unsharpMask(OIIO::ImageBuf& dst, const OIIO::ImageBuf& src, const std::string& kernel, float width, float contrast,
+            float threshold, OIIO::ROI roi = {}, int nthreads = 0);
+
+#endif  // !SHARPEN_H
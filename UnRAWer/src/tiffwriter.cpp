@@ -0,0 +1,422 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "pch.h"
+
+#include "tiffwriter.h"
+
+#include <OpenImageIO/parallel.h>
+#include <OpenImageIO/tiffutils.h>
+
+#include <bit>
+#include <cstring>
+#include <type_traits>
+
+#include <tiffio.h>
+#include <zlib.h>
+#include <zstd.h>
+
+using namespace OIIO;
+
+// Uncompressed strip size the rows per strip are derived from
+static constexpr size_t kStripBytes = size_t(1) << 20;
+
+// Horizontal differencing of one row (TIFF predictor 2), samples of a pixel are spp apart
+template<typename T>
+static void
+predictRow(T* row, size_t samples, int spp)
+{
+    for (size_t i = samples; i-- > size_t(spp);) {
+        row[i] = static_cast<T>(row[i] - row[i - spp]);
+    }
+}
+
+// TIFF floating point predictor (predictor 3) of one row: the bytes of the samples are split into
+// planes, most significant first, and the byte stream is differenced with a stride of spp
+static void
+predictFloatRow(uint8_t* row, uint8_t* tmp, size_t samples, int bps, int spp)
+{
+    std::memcpy(tmp, row, samples * bps);
+    for (size_t i = 0; i < samples; i++) {
+        for (int b = 0; b < bps; b++) {
+            int plane = std::endian::native == std::endian::big ? b : bps - b - 1;
+            row[plane * samples + i] = tmp[i * bps + b];
+        }
+    }
+    predictRow(row, samples * bps, spp);
+}
+
+static bool
+sampleFormat(TypeDesc format, uint16_t& sample_format)
+{
+    switch (format.basetype) {
+    case TypeDesc::UINT8:
+    case TypeDesc::UINT16:
+    case TypeDesc::UINT32: sample_format = SAMPLEFORMAT_UINT; return true;
+    case TypeDesc::INT8:
+    case TypeDesc::INT16:
+    case TypeDesc::INT32: sample_format = SAMPLEFORMAT_INT; return true;
+    case TypeDesc::HALF:
+    case TypeDesc::FLOAT:
+    case TypeDesc::DOUBLE: sample_format = SAMPLEFORMAT_IEEEFP; return true;
+    default: return false;
+    }
+}
+
+// Interoperability IFD pointer of the Exif IFD, libtiff has no writer for the sub IFD it points to
+static constexpr int kInteropIfdTag = 40965;
+
+// Packs the values of a field as its libtiff element type T
+template<typename T>
+static std::vector<uint8_t>
+packValues(const std::vector<double>& values)
+{
+    std::vector<uint8_t> packed(values.size() * sizeof(T));
+    for (size_t i = 0; i < values.size(); i++) {
+        T value;
+        if constexpr (std::is_floating_point_v<T>) {
+            value = static_cast<T>(values[i]);
+        } else {
+            value = static_cast<T>(static_cast<int64_t>(values[i]));
+        }
+        std::memcpy(packed.data() + i * sizeof(T), &value, sizeof(T));
+    }
+    return packed;
+}
+
+// Sets one Exif or GPS field from a spec attribute, converted to the value types libtiff expects for
+// the field. Attributes libtiff has no field for, or with fewer values than the field holds, are skipped.
+static void
+setMetadataField(TIFF* tif, const TagInfo& tag, const ParamValue& p)
+{
+    const TIFFField* field = TIFFFindField(tif, tag.tifftag, TIFF_ANY);
+    if (!field) {
+        return;
+    }
+    const TypeDesc type = p.type();
+    if (tag.tifftype == TIFF_ASCII) {
+        if (type == TypeString) {
+            TIFFSetField(tif, tag.tifftag, p.get_string().c_str());
+        }
+        return;
+    }
+
+    // version tags and other byte fields may be kept as strings
+    std::vector<double> values;
+    if (type == TypeString) {
+        if (tag.tifftype != TIFF_BYTE && tag.tifftype != TIFF_UNDEFINED) {
+            return;
+        }
+        for (char c : p.get_string()) {
+            values.push_back(static_cast<uint8_t>(c));
+        }
+    } else {
+        const int n = static_cast<int>(type.basevalues()) * p.nvalues();
+        for (int i = 0; i < n; i++) {
+            values.push_back(type.is_floating_point() ? p.get_float_indexed(i) : p.get_int_indexed(i));
+        }
+    }
+
+    const bool passcount = TIFFFieldPassCount(field);
+    const int fixed      = TIFFFieldWriteCount(field);
+    if (values.empty() || (!passcount && fixed > 0 && values.size() < size_t(fixed))) {
+        return;
+    }
+    if (!passcount && fixed > 0) {
+        values.resize(fixed);
+    }
+
+    bool real = false;
+    bool sign = false;
+    int size  = 1;
+    switch (tag.tifftype) {
+    case TIFF_SBYTE: sign = true; [[fallthrough]];
+    case TIFF_BYTE:
+    case TIFF_UNDEFINED: size = 1; break;
+    case TIFF_SSHORT: sign = true; [[fallthrough]];
+    case TIFF_SHORT: size = 2; break;
+    case TIFF_SLONG: sign = true; [[fallthrough]];
+    case TIFF_LONG: size = 4; break;
+    case TIFF_RATIONAL:
+    case TIFF_SRATIONAL:
+    case TIFF_FLOAT: real = true; size = 4; break;
+    case TIFF_DOUBLE: real = true; size = 8; break;
+    default: return;
+    }
+
+    // single values go through varargs promotion, rationals are read back as double by libtiff
+    if (!passcount && fixed == 1) {
+        if (real) {
+            TIFFSetField(tif, tag.tifftag, values[0]);
+        } else if (sign) {
+            TIFFSetField(tif, tag.tifftag, static_cast<int>(values[0]));
+        } else {
+            TIFFSetField(tif, tag.tifftag, static_cast<uint32_t>(static_cast<int64_t>(values[0])));
+        }
+        return;
+    }
+
+#if defined(TIFFLIB_MAJOR_VERSION)
+    // rational arrays are float or double depending on the field and the libtiff version
+    if (real) {
+        size = TIFFFieldSetGetSize(field);
+    }
+#endif
+    std::vector<uint8_t> packed;
+    if (real) {
+        packed = size == 8 ? packValues<double>(values) : packValues<float>(values);
+    } else if (size == 1) {
+        packed = sign ? packValues<int8_t>(values) : packValues<uint8_t>(values);
+    } else if (size == 2) {
+        packed = sign ? packValues<int16_t>(values) : packValues<uint16_t>(values);
+    } else {
+        packed = sign ? packValues<int32_t>(values) : packValues<uint32_t>(values);
+    }
+    if (passcount) {
+        TIFFSetField(tif, tag.tifftag, static_cast<uint32_t>(values.size()), packed.data());
+    } else {
+        TIFFSetField(tif, tag.tifftag, packed.data());
+    }
+}
+
+// Exif or GPS sub IFD holding the spec attributes of OIIO's tag table of the domain, written ahead of
+// the image IFD. Returns its offset, 0 if none.
+static uint64_t
+writeMetadataDirectory(TIFF* tif, const ImageSpec& spec, string_view domain)
+{
+    std::vector<std::pair<const TagInfo*, const ParamValue*>> fields;
+    for (const ParamValue& p : spec.extra_attribs) {
+        const TagInfo* tag = tag_lookup(domain, p.name());
+        if (tag && tag->tifftype != TIFF_IFD && tag->tifftype != TIFF_IFD8 && tag->tifftag != kInteropIfdTag) {
+            fields.emplace_back(tag, &p);
+        }
+    }
+    if (fields.empty()) {
+        return 0;
+    }
+
+    if (!(domain == "GPS" ? TIFFCreateGPSDirectory(tif) : TIFFCreateEXIFDirectory(tif))) {
+        return 0;
+    }
+    for (const auto& [tag, p] : fields) {
+        setMetadataField(tif, *tag, *p);
+    }
+
+    uint64_t offset = 0;
+    if (!TIFFWriteCustomDirectory(tif, &offset)) {
+        offset = 0;
+    }
+    TIFFCreateDirectory(tif);
+    return offset;
+}
+
+static void
+setStringTag(TIFF* tif, uint32_t tag, const std::string& value)
+{
+    if (!value.empty()) {
+        TIFFSetField(tif, tag, value.c_str());
+    }
+}
+
+bool
+tiffWriteParallel(const ImageBuf& buf, const ImageSpec& spec, int x, int y, const std::string& fileName,
+                  TiffCodec codec, int level)
+{
+    const TypeDesc format = spec.format;
+    uint16_t sample_format;
+    if (!sampleFormat(format, sample_format)) {
+        return false;
+    }
+
+    const int width        = spec.width;
+    const int height       = spec.height;
+    const int nch          = spec.nchannels;
+    const int bps          = static_cast<int>(format.size());
+    const size_t rowBytes  = size_t(width) * nch * bps;
+    const uint32_t rps     = static_cast<uint32_t>(std::clamp<size_t>(kStripBytes / rowBytes, 1, height));
+    const uint32_t nstrips = (height + rps - 1) / rps;
+
+    uint16_t predictor = PREDICTOR_NONE;
+    if (codec != TiffCodec::None) {
+        predictor = sample_format == SAMPLEFORMAT_IEEEFP ? PREDICTOR_FLOATINGPOINT : PREDICTOR_HORIZONTAL;
+    }
+
+    // BigTIFF once the uncompressed data may not fit 32bit offsets
+    const char* mode = rowBytes * height > (size_t(0xF0000000)) ? "w8" : "w";
+#ifdef _WIN32
+    std::u8string u8name(fileName.begin(), fileName.end());
+    TIFF* tif = TIFFOpenW(std::filesystem::path(u8name).wstring().c_str(), mode);
+#else
+    TIFF* tif = TIFFOpen(fileName.c_str(), mode);
+#endif
+    if (!tif) {
+        spdlog::error("TIFF: Cannot create {}", fileName);
+        return false;
+    }
+
+    uint64_t exif_offset = writeMetadataDirectory(tif, spec, "Exif");
+    uint64_t gps_offset  = writeMetadataDirectory(tif, spec, "GPS");
+
+    TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, uint32_t(width));
+    TIFFSetField(tif, TIFFTAG_IMAGELENGTH, uint32_t(height));
+    TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, uint16_t(nch));
+    TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, uint16_t(bps * 8));
+    TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT, sample_format);
+    TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+    TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, nch >= 3 ? PHOTOMETRIC_RGB : PHOTOMETRIC_MINISBLACK);
+    TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, rps);
+    TIFFSetField(tif, TIFFTAG_COMPRESSION, codec == TiffCodec::Deflate ? COMPRESSION_ADOBE_DEFLATE
+                                           : codec == TiffCodec::Zstd  ? COMPRESSION_ZSTD
+                                                                       : COMPRESSION_NONE);
+    if (predictor != PREDICTOR_NONE) {
+        TIFFSetField(tif, TIFFTAG_PREDICTOR, predictor);
+    }
+    int color_ch = nch >= 3 ? 3 : 1;
+    if (nch > color_ch) {
+        std::vector<uint16_t> extra(nch - color_ch, 0);
+        if (spec.alpha_channel == color_ch) {
+            extra[0] = EXTRASAMPLE_UNASSALPHA;
+        }
+        TIFFSetField(tif, TIFFTAG_EXTRASAMPLES, uint16_t(extra.size()), extra.data());
+    }
+
+    TIFFSetField(tif, TIFFTAG_ORIENTATION, uint16_t(spec.get_int_attribute("Orientation", 1)));
+    setStringTag(tif, TIFFTAG_MAKE, spec.get_string_attribute("Make"));
+    setStringTag(tif, TIFFTAG_MODEL, spec.get_string_attribute("Model"));
+    setStringTag(tif, TIFFTAG_SOFTWARE, spec.get_string_attribute("Software"));
+    setStringTag(tif, TIFFTAG_ARTIST, spec.get_string_attribute("Artist"));
+    setStringTag(tif, TIFFTAG_COPYRIGHT, spec.get_string_attribute("Copyright"));
+    setStringTag(tif, TIFFTAG_IMAGEDESCRIPTION, spec.get_string_attribute("ImageDescription"));
+    setStringTag(tif, TIFFTAG_DOCUMENTNAME, spec.get_string_attribute("DocumentName"));
+    setStringTag(tif, TIFFTAG_HOSTCOMPUTER, spec.get_string_attribute("HostComputer"));
+    if (spec.find_attribute("XResolution") && spec.find_attribute("YResolution")) {
+        std::string unit = spec.get_string_attribute("ResolutionUnit", "in");
+        TIFFSetField(tif, TIFFTAG_XRESOLUTION, double(spec.get_float_attribute("XResolution")));
+        TIFFSetField(tif, TIFFTAG_YRESOLUTION, double(spec.get_float_attribute("YResolution")));
+        TIFFSetField(tif, TIFFTAG_RESOLUTIONUNIT, unit == "cm"     ? RESUNIT_CENTIMETER
+                                                  : unit == "none" ? RESUNIT_NONE
+                                                                   : RESUNIT_INCH);
+    }
+    std::string datetime = spec.get_string_attribute("DateTime");
+    if (datetime.size() >= 10) {
+        // TIFF dates are "YYYY:MM:DD HH:MM:SS"
+        datetime[4] = datetime[7] = ':';
+        TIFFSetField(tif, TIFFTAG_DATETIME, datetime.c_str());
+    }
+    if (const ParamValue* icc = spec.find_attribute("ICCProfile")) {
+        TIFFSetField(tif, TIFFTAG_ICCPROFILE, uint32_t(icc->datasize()), icc->data());
+    }
+    std::string xmp = encode_xmp(spec, true);
+    if (!xmp.empty()) {
+        TIFFSetField(tif, TIFFTAG_XMLPACKET, uint32_t(xmp.size()), xmp.data());
+    }
+    std::vector<char> iptc;
+    encode_iptc_iim(spec, iptc);
+    if (!iptc.empty()) {
+        // RichTIFFIPTC is stored as 32bit words
+        iptc.resize((iptc.size() + 3) & ~size_t(3));
+        TIFFSetField(tif, TIFFTAG_RICHTIFFIPTC, uint32_t(iptc.size() / 4), iptc.data());
+    }
+    if (exif_offset) {
+        TIFFSetField(tif, TIFFTAG_EXIFIFD, exif_offset);
+    }
+    if (gps_offset) {
+        TIFFSetField(tif, TIFFTAG_GPSIFD, gps_offset);
+    }
+
+    // strips are compressed a batch at a time and appended in order, so at most a batch of
+    // compressed strips is held in memory
+    const uint32_t batch = std::max(1u, std::thread::hardware_concurrency()) * 4;
+    std::vector<std::vector<uint8_t>> packed(std::min(batch, nstrips));
+    std::atomic<bool> ok { true };
+    size_t written = 0;
+
+    for (uint32_t first = 0; first < nstrips && ok; first += batch) {
+        const uint32_t last = std::min(first + batch, nstrips);
+        parallel_for(int64_t(first), int64_t(last), [&](int64_t s) {
+            thread_local std::vector<uint8_t> raw, tmp;
+            const int y0      = int(s) * rps;
+            const int rows    = std::min<int>(rps, height - y0);
+            const size_t size = rowBytes * rows;
+            raw.resize(size);
+            ROI roi(x, x + width, y + y0, y + y0 + rows, 0, 1, 0, nch);
+            if (!buf.get_pixels(roi, format, raw.data())) {
+                ok = false;
+                return;
+            }
+
+            for (int r = 0; r < rows && predictor != PREDICTOR_NONE; r++) {
+                uint8_t* row = raw.data() + rowBytes * r;
+                const size_t samples = size_t(width) * nch;
+                if (predictor == PREDICTOR_FLOATINGPOINT) {
+                    tmp.resize(rowBytes);
+                    predictFloatRow(row, tmp.data(), samples, bps, nch);
+                } else if (bps == 1) {
+                    predictRow(row, samples, nch);
+                } else if (bps == 2) {
+                    predictRow(reinterpret_cast<uint16_t*>(row), samples, nch);
+                } else {
+                    predictRow(reinterpret_cast<uint32_t*>(row), samples, nch);
+                }
+            }
+
+            std::vector<uint8_t>& out = packed[s - first];
+            if (codec == TiffCodec::Deflate) {
+                uLongf len = compressBound(uLong(size));
+                out.resize(len);
+                if (compress2(out.data(), &len, raw.data(), uLong(size), level) != Z_OK) {
+                    ok = false;
+                    return;
+                }
+                out.resize(len);
+            } else if (codec == TiffCodec::Zstd) {
+                out.resize(ZSTD_compressBound(size));
+                size_t len = ZSTD_compress(out.data(), out.size(), raw.data(), size, level);
+                if (ZSTD_isError(len)) {
+                    spdlog::error("TIFF: zstd: {}", ZSTD_getErrorName(len));
+                    ok = false;
+                    return;
+                }
+                out.resize(len);
+            } else {
+                out.assign(raw.begin(), raw.begin() + size);
+            }
+        });
+
+        for (uint32_t s = first; s < last && ok; s++) {
+            auto& out = packed[s - first];
+            if (TIFFWriteRawStrip(tif, s, out.data(), tmsize_t(out.size())) != tmsize_t(out.size())) {
+                spdlog::error("TIFF: Cannot write strip {} of {}", s, fileName);
+                ok = false;
+            }
+            written += out.size();
+        }
+    }
+
+    if (ok && !TIFFWriteDirectory(tif)) {
+        ok = false;
+    }
+    TIFFClose(tif);
+
+    if (ok) {
+        spdlog::debug("TIFF: {} strips of {} rows, {:.1f}% of raw size", nstrips, rps,
+                      100.0 * double(written) / double(rowBytes * height));
+    } else {
+        spdlog::error("TIFF: Cannot write {}", fileName);
+    }
+    return ok;
+}
@@ -0,0 +1,38 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#ifndef TIFFWRITER_H
+#    define TIFFWRITER_H
+
+#    include <OpenImageIO/imagebuf.h>
+
+#    include <string>
+
+// TIFF compression of the strip parallel writer
+enum class TiffCodec { None, Deflate, Zstd };
+
+// Writes a TIFF with libtiff, strips are predicted and compressed concurrently on OIIO's thread pool
+// and appended in order with TIFFWriteRawStrip. spec gives the written size and metadata, pixels are
+// read from buf starting at (x, y). Basic tags, the Exif and GPS IFDs from OIIO's tag tables, XMP, IPTC and
+// the ICC profile are kept.
+bool
+tiffWriteParallel(const OIIO::ImageBuf& buf, const OIIO::ImageSpec& spec, int x, int y, const std::string& fileName,
+                  TiffCodec codec, int level);
+
+#endif  // !TIFFWRITER_H
@@ -0,0 +1,129 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "pch.h"
+
+#include "tiledproc.h"
+#include "rangeconv.h"
+#include "sharpen.h"
+
+#include <OpenImageIO/imagebufalgo.h>
+#include <OpenImageIO/parallel.h>
+
+using namespace OIIO;
+
+// Output tile size, a float RGB tile with halo stays within a typical L2
+static constexpr int kTile = 128;
+
+// Float tile buffer wrapped by an ImageBuf, reused by a worker thread for all its tiles
+struct TileBuf {
+    std::vector<float> pixels;
+    ImageBuf buf;
+
+    ImageBuf& wrap(ROI roi, int nch)
+    {
+        ImageSpec spec(roi.width(), roi.height(), nch, TypeDesc::FLOAT);
+        spec.x = roi.xbegin;
+        spec.y = roi.ybegin;
+        pixels.resize(size_t(roi.width()) * roi.height() * nch);
+        buf.reset(spec, pixels.data());
+        return buf;
+    }
+};
+
+bool
+tiledProcess(const ImageBuf& src, ImageBuf& dst, TypeDesc out_format, const TileOps& ops)
+{
+    const ImageSpec& src_spec = src.spec();
+    const int nch             = src_spec.nchannels;
+    const ROI full            = src.roi();
+    const int alpha           = src_spec.alpha_channel;
+
+    if (!dst.initialized()) {
+        ImageSpec dst_spec = src_spec;
+        dst_spec.set_format(out_format);
+        dst.reset(dst_spec, InitializePixels::No);
+    }
+
+    // unsharp reads up to half the kernel width around each pixel
+    const int halo    = ops.sharpen ? int(std::ceil(ops.width * 0.5f)) + 1 : 0;
+    const int tiles_x = (full.width() + kTile - 1) / kTile;
+    const int tiles_y = (full.height() + kTile - 1) / kTile;
+
+    std::atomic<bool> ok { true };
+    parallel_for(int64_t(0), int64_t(tiles_x) * tiles_y, [&](int64_t t) {
+        if (!ok) {
+            return;
+        }
+        thread_local TileBuf in_tile, lut_tile, uns_tile;
+
+        const int tx = int(t % tiles_x);
+        const int ty = int(t / tiles_x);
+        ROI out_roi(full.xbegin + tx * kTile, std::min(full.xbegin + (tx + 1) * kTile, full.xend),
+                    full.ybegin + ty * kTile, std::min(full.ybegin + (ty + 1) * kTile, full.yend), 0, 1, 0, nch);
+        ROI in_roi(std::max(out_roi.xbegin - halo, full.xbegin), std::min(out_roi.xend + halo, full.xend),
+                   std::max(out_roi.ybegin - halo, full.ybegin), std::min(out_roi.yend + halo, full.yend), 0, 1, 0,
+                   nch);
+
+        ImageBuf& in_buf = in_tile.wrap(in_roi, nch);
+        if (!src.get_pixels(in_roi, TypeDesc::FLOAT, in_tile.pixels.data())) {
+            ok = false;
+            return;
+        }
+
+        TileBuf* cur = &in_tile;
+        if (ops.lut) {
+            ImageBuf& lut_buf = lut_tile.wrap(in_roi, nch);
+            if (!ops.lut(lut_buf, in_buf, 1)) {
+                spdlog::error("Tiles: LUT failed: {}", lut_buf.geterror());
+                ok = false;
+                return;
+            }
+            cur = &lut_tile;
+        }
+
+        if (ops.sharpen) {
+            ImageBuf& uns_buf = uns_tile.wrap(in_roi, nch);
+            if (!unsharpMask(uns_buf, cur->buf, ops.kernel, ops.width, ops.contrast, ops.threshold, in_roi, 1)) {
+                spdlog::error("Tiles: Unsharp mask failed: {}", uns_buf.geterror());
+                ok = false;
+                return;
+            }
+            cur = &uns_tile;
+        }
+
+        // only the tile center goes out, range mapped and converted to the output format
+        const size_t row = size_t(in_roi.width()) * nch;
+        float* center    = cur->pixels.data() + size_t(out_roi.ybegin - in_roi.ybegin) * row
+                        + size_t(out_roi.xbegin - in_roi.xbegin) * nch;
+        if (ops.range.active()) {
+            for (int y = 0; y < out_roi.height(); y++) {
+                applyRange(center + y * row, out_roi.width(), nch, alpha, ops.range);
+            }
+        }
+        const stride_t xstride = stride_t(nch) * sizeof(float);
+        const stride_t ystride = stride_t(row) * sizeof(float);
+        if (!dst.set_pixels(out_roi, TypeDesc::FLOAT, center, xstride, ystride)) {
+            ok = false;
+        }
+    });
+
+    if (!ok) {
+        dst.reset();
+    }
+    return ok;
+}
@@ -0,0 +1,50 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#ifndef TILEDPROC_H
+#    define TILEDPROC_H
+
+#    include "rangeconv.h"
+
+#    include <OpenImageIO/imagebuf.h>
+
+#    include <functional>
+#    include <string>
+
+// Per tile processing steps, a step is skipped when it is not set
+struct TileOps {
+    // LUT transform of a tile: (dst, src, nthreads)
+    std::function<bool(OIIO::ImageBuf&, const OIIO::ImageBuf&, int)> lut;
+
+    bool sharpen = false;
+    std::string kernel;
+    float width     = 3.0f;
+    float contrast  = 1.0f;
+    float threshold = 0.0f;
+
+    RangeMap range;  // applied to the tile centers before the output conversion
+};
+
+// Runs LUT -> unsharp mask -> range mapping -> output format conversion tile by tile, so each tile
+// stays in cache between the steps. Tiles are read with a halo wide enough for the sharpen kernel, dst receives the
+// tile centers only; it is allocated with out_format pixels unless it is already initialized.
+bool
+tiledProcess(const OIIO::ImageBuf& src, OIIO::ImageBuf& dst, OIIO::TypeDesc out_format, const TileOps& ops);
+
+#endif  // !TILEDPROC_H
@@ -0,0 +1,201 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#ifndef UNRWIMAGE_H
+#    define UNRWIMAGE_H
+
+// UNRW image: an uncompressed container for handing pixels to other tools without a decode step.
+// This header has no dependencies, copy it into the consuming project and map the file.
+//
+// Layout, all fields little-endian:
+//   Header        128 bytes, see unrw::Header
+//   metadata      OpenImageIO ImageSpec serialized as XML (channel names, colour space, camera attributes)
+//   exif          TIFF structured Exif block (no "Exif\0\0" prefix), may be empty
+//   pixels        starts on a 64 byte boundary, every row starts on a 64 byte boundary
+//     interleaved: height rows of width * channels samples, rowStride bytes apart
+//     planar:      channels planes of height rows of width samples, planeStride bytes apart
+// Sample types are the Export.BitDepth values. Rows are top to bottom in the written orientation,
+// the Exif orientation of the image is repeated in the header.
+
+#    include <cstddef>
+#    include <cstdint>
+#    include <cstring>
+#    include <string>
+
+#    ifdef _WIN32
+#        ifndef WIN32_LEAN_AND_MEAN
+#            define WIN32_LEAN_AND_MEAN
+#        endif
+#        ifndef NOMINMAX
+#            define NOMINMAX
+#        endif
+#        include <windows.h>
+#    else
+#        include <fcntl.h>
+#        include <sys/mman.h>
+#        include <sys/stat.h>
+#        include <unistd.h>
+#    endif
+
+namespace unrw {
+
+constexpr char kMagic[8]      = { 'U', 'N', 'R', 'W', 'I', 'M', 'G', '\0' };
+constexpr uint32_t kVersion   = 1;
+constexpr uint64_t kAlignment = 64;
+
+enum SampleType : uint32_t { UInt8 = 0, UInt16 = 1, UInt32 = 2, UInt64 = 3, Half = 4, Float = 5, Double = 6 };
+
+enum Layout : uint32_t { Interleaved = 0, Planar = 1 };
+
+struct Header {
+    char magic[8];            // kMagic
+    uint32_t version;         // kVersion
+    uint32_t headerSize;      // sizeof(Header)
+    uint32_t width;           // pixels
+    uint32_t height;          // rows
+    uint32_t channels;        // samples per pixel
+    uint32_t sampleType;      // SampleType
+    uint32_t sampleSize;      // bytes per sample
+    uint32_t layout;          // Layout
+    int32_t alphaChannel;     // -1 - no alpha
+    uint32_t orientation;     // Exif orientation 1-8
+    uint64_t rowStride;       // bytes between rows
+    uint64_t planeStride;     // bytes between planes, 0 - interleaved
+    uint64_t dataOffset;      // first pixel row from the file start
+    uint64_t dataSize;        // bytes of pixel data including row padding
+    uint64_t metadataOffset;  // XML metadata
+    uint64_t metadataSize;
+    uint64_t exifOffset;      // Exif block
+    uint64_t exifSize;
+    uint8_t reserved[16];
+};
+static_assert(sizeof(Header) == 128, "UNRW header must be 128 bytes");
+
+// Header of a mapped file, nullptr if data is not a complete UNRW image of this version
+inline const Header*
+header(const void* data, size_t size)
+{
+    if (data == nullptr || size < sizeof(Header)) {
+        return nullptr;
+    }
+    const Header* h = static_cast<const Header*>(data);
+    if (std::memcmp(h->magic, kMagic, sizeof(kMagic)) != 0 || h->version != kVersion
+        || h->headerSize != sizeof(Header) || h->dataOffset % kAlignment != 0 || h->dataOffset > size
+        || h->dataSize > size - h->dataOffset || h->metadataOffset + h->metadataSize > size
+        || h->exifOffset + h->exifSize > size) {
+        return nullptr;
+    }
+    return h;
+}
+
+// First sample of row y (of plane c for planar images)
+inline const void*
+row(const Header* h, uint32_t y, uint32_t c = 0)
+{
+    const uint8_t* base = reinterpret_cast<const uint8_t*>(h) + h->dataOffset;
+    return base + (h->layout == Planar ? h->planeStride * c : 0) + h->rowStride * y;
+}
+
+inline std::string
+metadata(const Header* h)
+{
+    return std::string(reinterpret_cast<const char*>(h) + h->metadataOffset, h->metadataSize);
+}
+
+inline const void*
+exif(const Header* h)
+{
+    return h->exifSize ? reinterpret_cast<const uint8_t*>(h) + h->exifOffset : nullptr;
+}
+
+// Read-only mapping of an UNRW image, header() is nullptr if the file cannot be mapped or is not valid
+class MappedImage {
+public:
+    explicit MappedImage(const std::string& fileName)
+    {
+#    ifdef _WIN32
+        int wlen = MultiByteToWideChar(CP_UTF8, 0, fileName.c_str(), -1, nullptr, 0);
+        std::wstring wname(wlen > 0 ? wlen - 1 : 0, L'\0');
+        MultiByteToWideChar(CP_UTF8, 0, fileName.c_str(), -1, wname.data(), wlen);
+        HANDLE file = CreateFileW(wname.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                  FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return;
+        }
+        LARGE_INTEGER size;
+        if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+            m_mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (m_mapping) {
+                m_data = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+                m_size = size_t(size.QuadPart);
+            }
+        }
+        CloseHandle(file);
+#    else
+        int fd = ::open(fileName.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+            if (data != MAP_FAILED) {
+                m_data = data;
+                m_size = size_t(st.st_size);
+            }
+        }
+        ::close(fd);
+#    endif
+        m_header = unrw::header(m_data, m_size);
+    }
+
+    ~MappedImage()
+    {
+#    ifdef _WIN32
+        if (m_data) {
+            UnmapViewOfFile(m_data);
+        }
+        if (m_mapping) {
+            CloseHandle(m_mapping);
+        }
+#    else
+        if (m_data) {
+            munmap(m_data, m_size);
+        }
+#    endif
+    }
+
+    MappedImage(const MappedImage&)            = delete;
+    MappedImage& operator=(const MappedImage&) = delete;
+
+    const Header* header() const { return m_header; }
+    const void* row(uint32_t y, uint32_t c = 0) const { return unrw::row(m_header, y, c); }
+
+private:
+    void* m_data           = nullptr;
+    size_t m_size          = 0;
+    const Header* m_header = nullptr;
+#    ifdef _WIN32
+    HANDLE m_mapping = nullptr;
+#    endif
+};
+
+}  // namespace unrw
+
+#endif  // !UNRWIMAGE_H
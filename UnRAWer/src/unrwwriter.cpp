@@ -0,0 +1,239 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "pch.h"
+
+#include "unrwwriter.h"
+#include "unrwimage.h"
+
+#include <OpenImageIO/parallel.h>
+#include <OpenImageIO/tiffutils.h>
+
+#ifndef _WIN32
+#    include <fcntl.h>
+#endif
+
+using namespace OIIO;
+
+// Pixel data written per task
+static constexpr size_t kBandBytes = size_t(4) << 20;
+
+static uint64_t
+alignUp(uint64_t value)
+{
+    return (value + unrw::kAlignment - 1) / unrw::kAlignment * unrw::kAlignment;
+}
+
+static bool
+sampleType(TypeDesc format, uint32_t& type)
+{
+    switch (format.basetype) {
+    case TypeDesc::UINT8: type = unrw::UInt8; return true;
+    case TypeDesc::UINT16: type = unrw::UInt16; return true;
+    case TypeDesc::UINT32: type = unrw::UInt32; return true;
+    case TypeDesc::UINT64: type = unrw::UInt64; return true;
+    case TypeDesc::HALF: type = unrw::Half; return true;
+    case TypeDesc::FLOAT: type = unrw::Float; return true;
+    case TypeDesc::DOUBLE: type = unrw::Double; return true;
+    default: return false;
+    }
+}
+
+// File opened for positional writes, pwrite on POSIX and WriteFile with an explicit offset on Windows.
+// Both are safe to call from several threads at once.
+class PositionalFile {
+public:
+    PositionalFile(const std::string& fileName, uint64_t size)
+    {
+#ifdef _WIN32
+        std::u8string u8name(fileName.begin(), fileName.end());
+        m_file = CreateFileW(std::filesystem::path(u8name).wstring().c_str(), GENERIC_WRITE, 0, nullptr,
+                             CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (m_file == INVALID_HANDLE_VALUE) {
+            m_file = nullptr;
+            return;
+        }
+        // reserve the full size up front so the writes do not extend the file piecemeal
+        LARGE_INTEGER end;
+        end.QuadPart = LONGLONG(size);
+        if (SetFilePointerEx(m_file, end, nullptr, FILE_BEGIN)) {
+            SetEndOfFile(m_file);
+        }
+#else
+        m_fd = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (m_fd >= 0 && ftruncate(m_fd, off_t(size)) != 0) {
+            spdlog::debug("UNRW: Cannot preallocate {}", fileName);
+        }
+#endif
+    }
+
+    ~PositionalFile() { close(); }
+
+    bool valid() const
+    {
+#ifdef _WIN32
+        return m_file != nullptr;
+#else
+        return m_fd >= 0;
+#endif
+    }
+
+    bool write(const void* data, size_t size, uint64_t offset)
+    {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        while (size > 0) {
+#ifdef _WIN32
+            DWORD chunk = DWORD(std::min<size_t>(size, 1u << 30));
+            DWORD done  = 0;
+            OVERLAPPED ov {};
+            ov.Offset     = DWORD(offset & 0xFFFFFFFF);
+            ov.OffsetHigh = DWORD(offset >> 32);
+            if (!WriteFile(m_file, p, chunk, &done, &ov) || done == 0) {
+                return false;
+            }
+#else
+            ssize_t done = pwrite(m_fd, p, size, off_t(offset));
+            if (done <= 0) {
+                if (done < 0 && errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+#endif
+            p += done;
+            size -= size_t(done);
+            offset += uint64_t(done);
+        }
+        return true;
+    }
+
+    bool close()
+    {
+        bool ok = true;
+#ifdef _WIN32
+        if (m_file) {
+            ok     = CloseHandle(m_file) != 0;
+            m_file = nullptr;
+        }
+#else
+        if (m_fd >= 0) {
+            ok   = ::close(m_fd) == 0;
+            m_fd = -1;
+        }
+#endif
+        return ok;
+    }
+
+private:
+#ifdef _WIN32
+    HANDLE m_file = nullptr;
+#else
+    int m_fd = -1;
+#endif
+};
+
+bool
+unrwWrite(const ImageBuf& buf, const ImageSpec& spec, int x, int y, const std::string& fileName, bool planar)
+{
+    unrw::Header header {};
+    if (!sampleType(spec.format, header.sampleType)) {
+        spdlog::error("UNRW: {} samples are not supported", spec.format.c_str());
+        return false;
+    }
+    const int width  = spec.width;
+    const int height = spec.height;
+    const int nch    = spec.nchannels;
+    if (width < 1 || height < 1 || nch < 1) {
+        return false;
+    }
+
+    std::string metadata = spec.serialize(ImageSpec::SerialXML, ImageSpec::SerialDetailed);
+    std::vector<char> exif;
+    encode_exif(spec, exif);
+
+    std::memcpy(header.magic, unrw::kMagic, sizeof(unrw::kMagic));
+    header.version        = unrw::kVersion;
+    header.headerSize     = sizeof(unrw::Header);
+    header.width          = uint32_t(width);
+    header.height         = uint32_t(height);
+    header.channels       = uint32_t(nch);
+    header.sampleSize     = uint32_t(spec.format.size());
+    header.layout         = planar ? unrw::Planar : unrw::Interleaved;
+    header.alphaChannel   = spec.alpha_channel;
+    header.orientation    = uint32_t(spec.get_int_attribute("Orientation", 1));
+    header.rowStride      = alignUp(uint64_t(width) * (planar ? 1 : nch) * header.sampleSize);
+    header.planeStride    = planar ? header.rowStride * height : 0;
+    header.metadataOffset = sizeof(unrw::Header);
+    header.metadataSize   = metadata.size();
+    header.exifOffset     = header.metadataOffset + header.metadataSize;
+    header.exifSize       = exif.size();
+    header.dataOffset     = alignUp(header.exifOffset + header.exifSize);
+    header.dataSize       = planar ? header.planeStride * nch : header.rowStride * height;
+
+    std::vector<uint8_t> prefix(header.dataOffset, 0);
+    std::memcpy(prefix.data(), &header, sizeof(header));
+    std::memcpy(prefix.data() + header.metadataOffset, metadata.data(), metadata.size());
+    if (!exif.empty()) {
+        std::memcpy(prefix.data() + header.exifOffset, exif.data(), exif.size());
+    }
+
+    PositionalFile file(fileName, header.dataOffset + header.dataSize);
+    if (!file.valid()) {
+        spdlog::error("UNRW: Cannot create {}", fileName);
+        return false;
+    }
+    if (!file.write(prefix.data(), prefix.size(), 0)) {
+        spdlog::error("UNRW: Cannot write {}", fileName);
+        return false;
+    }
+
+    const size_t rowBytes = size_t(width) * (planar ? 1 : nch) * header.sampleSize;
+    const int bandRows    = int(std::clamp<uint64_t>(kBandBytes / header.rowStride, 1, uint64_t(height)));
+    const int bands       = (height + bandRows - 1) / bandRows;
+    const int planes      = planar ? nch : 1;
+
+    std::atomic<bool> ok { true };
+    parallel_for(int64_t(0), int64_t(bands) * planes, [&](int64_t task) {
+        thread_local std::vector<uint8_t> block;
+        const int plane = int(task / bands);
+        const int y0    = int(task % bands) * bandRows;
+        const int rows  = std::min(bandRows, height - y0);
+        block.resize(header.rowStride * rows);
+        if (header.rowStride > rowBytes) {
+            for (int r = 0; r < rows; r++) {
+                std::memset(block.data() + header.rowStride * r + rowBytes, 0, header.rowStride - rowBytes);
+            }
+        }
+        ROI roi(x, x + width, y + y0, y + y0 + rows, 0, 1, planar ? plane : 0, planar ? plane + 1 : nch);
+        if (!buf.get_pixels(roi, spec.format, block.data(), AutoStride, stride_t(header.rowStride))) {
+            ok = false;
+            return;
+        }
+        const uint64_t offset = header.dataOffset + header.planeStride * plane + header.rowStride * y0;
+        if (!file.write(block.data(), block.size(), offset)) {
+            ok = false;
+        }
+    });
+    if (!file.close() || !ok) {
+        spdlog::error("UNRW: Cannot write {}", fileName);
+        return false;
+    }
+
+    spdlog::debug("UNRW: {} {}x{}x{} {} {}, {} bands", fileName, width, height, nch, spec.format.c_str(),
+                  planar ? "planar" : "interleaved", bands * planes);
+    return true;
+}
@@ -0,0 +1,34 @@
+/*
+ * UnRAWer - camera raw batch processor
+ * Copyright (c) 2024 Erium Vladlen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#ifndef UNRWWRITER_H
+#    define UNRWWRITER_H
+
+#    include <OpenImageIO/imagebuf.h>
+
+#    include <string>
+
+// Writes an uncompressed UNRW image (see unrwimage.h) in the pixel format of spec, planar or interleaved.
+// Bands of rows are converted concurrently and written with positional writes at their final offsets.
+// spec gives the written size and metadata, pixels are read from buf starting at (x, y).
+bool
+unrwWrite(const OIIO::ImageBuf& buf, const OIIO::ImageSpec& spec, int x, int y, const std::string& fileName,
+          bool planar);
+
+#endif  // !UNRWWRITER_H